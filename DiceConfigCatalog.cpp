@@ -0,0 +1,383 @@
+/*
+ * DiceConfigCatalog - Configs of many dice in struct-of-arrays form
+ */
+
+#include "DiceConfigCatalog.h"
+
+// State of one loadDirectory() walk
+struct CatalogLoad {
+  DiceConfigCatalog* catalog;
+  DiceConfigStorage* storage;
+  size_t added;
+};
+
+DiceConfigCatalog::DiceConfigCatalog()
+  : _tumbleConstants(nullptr), _sleepTimeouts(nullptr), _colors(nullptr),
+    _macs(nullptr), _rssiLimits(nullptr), _flags(nullptr), _switchPoints(nullptr),
+    _macSlots(nullptr), _macMask(0), _block(nullptr), _blockSize(0), _size(0), _capacity(0),
+    _failed(0), _lastError("") {
+}
+
+DiceConfigCatalog::~DiceConfigCatalog() {
+  end();
+}
+
+bool DiceConfigCatalog::begin(size_t capacity, size_t idBytes) {
+  end();
+
+  // Entries are stored as entry << 2 in the MAC table
+  if (capacity == 0 || capacity > (MAC_EMPTY >> 4)) {
+    return fail("Invalid catalog capacity");
+  }
+
+  // Up to 3 MACs per entry, table at most 3/4 full
+  size_t slots = 1;
+  while (slots < capacity * 4) {
+    slots <<= 1;
+  }
+  size_t blockSize = slots * sizeof(uint32_t) + capacity * bytesPerEntry();
+  _block = malloc(blockSize);
+  if (_block == nullptr) {
+    return fail("Not enough memory for the catalog");
+  }
+  _blockSize = blockSize;
+  if (!_ids.begin(capacity, idBytes != 0 ? idBytes : capacity * DICE_CONFIG_CATALOG_ID_BYTES)) {
+    end();
+    return fail("Not enough memory for the catalog");
+  }
+
+  // Carve the table and columns, 4-byte ones first so all stay aligned
+  uint8_t* next = (uint8_t*)_block;
+  _macSlots = (uint32_t*)next;
+  _macMask = (uint32_t)(slots - 1);
+  memset(_macSlots, 0xFF, slots * sizeof(uint32_t));
+  next += slots * sizeof(uint32_t);
+  _tumbleConstants = (float*)next;
+  next += capacity * sizeof(float);
+  _sleepTimeouts = (uint32_t*)next;
+  next += capacity * sizeof(uint32_t);
+  _colors = (uint16_t (*)[DICE_COLOR_COUNT])next;
+  next += capacity * sizeof(_colors[0]);
+  _macs = (uint8_t (*)[3][6])next;
+  next += capacity * sizeof(_macs[0]);
+  _rssiLimits = (int8_t*)next;
+  next += capacity;
+  _flags = next;
+  next += capacity;
+  _switchPoints = next;
+
+  _capacity = capacity;
+  return true;
+}
+
+void DiceConfigCatalog::end() {
+  free(_block);
+  _block = nullptr;
+  _blockSize = 0;
+  _macSlots = nullptr;
+  _macMask = 0;
+  _ids.end();
+  _tumbleConstants = nullptr;
+  _sleepTimeouts = nullptr;
+  _colors = nullptr;
+  _macs = nullptr;
+  _rssiLimits = nullptr;
+  _flags = nullptr;
+  _switchPoints = nullptr;
+  _size = 0;
+  _capacity = 0;
+  _failed = 0;
+}
+
+void DiceConfigCatalog::clear() {
+  if (_macSlots != nullptr) {
+    memset(_macSlots, 0xFF, ((size_t)_macMask + 1) * sizeof(uint32_t));
+  }
+  _ids.clear();
+  _size = 0;
+  _failed = 0;
+}
+
+int DiceConfigCatalog::add(const DiceConfig& config) {
+  if (_size == _capacity) {
+    fail("Catalog full");
+    return -1;
+  }
+  if (DiceConfigParser::validate(config) != 0) {
+    fail("Config validation failed");
+    return -1;
+  }
+  if (!macsAvailable(config, -1)) {
+    return -1;
+  }
+  if (!assignId(_size, config)) {
+    return -1;
+  }
+  store(_size, config);
+  indexMacs(_size);
+  return (int)_size++;
+}
+
+bool DiceConfigCatalog::set(size_t index, const DiceConfig& config) {
+  if (index >= _size) {
+    return fail("Catalog index out of range");
+  }
+  if (DiceConfigParser::validate(config) != 0) {
+    return fail("Config validation failed");
+  }
+  if (!macsAvailable(config, (long)index) || !assignId(index, config)) {
+    return false;
+  }
+  unindexMacs(index);
+  store(index, config);
+  indexMacs(index);
+  return true;
+}
+
+bool DiceConfigCatalog::remove(size_t index) {
+  if (index >= _size) {
+    return fail("Catalog index out of range");
+  }
+  unindexMacs(index);
+  _ids.remove(index);
+  _size--;
+  if (index != _size) {
+    move(index, _size);
+
+    // The moved entry's slots still point at its old row (still intact)
+    for (uint32_t r = 0; r < 3; r++) {
+      long slot = findMacSlot(packMac(_macs[index][r]));
+      if (slot >= 0 && _macSlots[slot] == ((uint32_t)_size << 2 | r)) {
+        _macSlots[slot] = (uint32_t)index << 2 | r;
+      }
+    }
+  }
+  return true;
+}
+
+bool DiceConfigCatalog::get(size_t index, DiceConfig& config) const {
+  if (index >= _size) {
+    return false;
+  }
+
+  memset(&config, 0, sizeof(config));
+  strncpy(config.diceId, _ids.id(index), sizeof(config.diceId) - 1);
+  memcpy(config.deviceA_mac, _macs[index][0], 6);
+  memcpy(config.deviceB1_mac, _macs[index][1], 6);
+  memcpy(config.deviceB2_mac, _macs[index][2], 6);
+  config.x_background = _colors[index][DICE_COLOR_X_BACKGROUND];
+  config.y_background = _colors[index][DICE_COLOR_Y_BACKGROUND];
+  config.z_background = _colors[index][DICE_COLOR_Z_BACKGROUND];
+  config.entang_ab1_color = _colors[index][DICE_COLOR_ENTANG_AB1];
+  config.entang_ab2_color = _colors[index][DICE_COLOR_ENTANG_AB2];
+  config.rssiLimit = _rssiLimits[index];
+  config.isSMD = (_flags[index] & DICE_FLAG_SMD) != 0;
+  config.isNano = (_flags[index] & DICE_FLAG_NANO) != 0;
+  config.alwaysSeven = (_flags[index] & DICE_FLAG_ALWAYS_SEVEN) != 0;
+  config.randomSwitchPoint = _switchPoints[index];
+  config.tumbleConstant = _tumbleConstants[index];
+  config.deepSleepTimeout = _sleepTimeouts[index];
+  config.checksum = DiceConfigParser::checksum(config);
+  return true;
+}
+
+bool DiceConfigCatalog::loadFile(DiceConfigStorage& storage, const char* path) {
+  DiceConfigStorage::File file;
+  if (!storage.open(file, path, "r")) {
+    return fail("Failed to open config file");
+  }
+
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+  DiceLineReader reader(file);
+  char line[128];
+  while (reader.readLine(line, sizeof(line)) >= 0) {
+    DiceConfigParser::parseLine(line, config);
+  }
+  file.close();
+
+  return add(config) >= 0;
+}
+
+size_t DiceConfigCatalog::loadDirectory(DiceConfigStorage& storage, const DicePatternSet& patterns) {
+  CatalogLoad load = { this, &storage, 0 };
+  if (!patterns.walk(storage, visitFile, &load)) {
+    fail("Failed to open root directory");
+  }
+  return load.added;
+}
+
+void DiceConfigCatalog::visitFile(const char* path, int priority, const DiceFileInfo& info,
+                                  void* context) {
+  (void)priority;
+  (void)info;
+  CatalogLoad& load = *(CatalogLoad*)context;
+
+  char fullPath[130];
+  snprintf(fullPath, sizeof(fullPath), "/%s", path);
+  if (load.catalog->loadFile(*load.storage, fullPath)) {
+    load.added++;
+  } else {
+    load.catalog->_failed++;
+  }
+}
+
+size_t DiceConfigCatalog::loadManifest(DiceConfigStorage& storage, const char* manifestPath) {
+  CatalogLoad load = { this, &storage, 0 };
+  if (!storage.exists(manifestPath)) {
+    fail("Failed to open manifest");
+    return 0;
+  }
+  DiceManifest::forEach(storage, manifestPath, visitSection, &load);
+  return load.added;
+}
+
+void DiceConfigCatalog::visitSection(const char* name, const DiceConfig& config, void* context) {
+  (void)name;
+  CatalogLoad& load = *(CatalogLoad*)context;
+  if (load.catalog->add(config) >= 0) {
+    load.added++;
+  } else {
+    load.catalog->_failed++;
+  }
+}
+
+int DiceConfigCatalog::findByMac(const uint8_t* mac, uint8_t* role) const {
+  uint64_t key = packMac(mac);
+  long slot = key != 0 ? findMacSlot(key) : -1;
+  if (slot < 0) {
+    return -1;
+  }
+  uint32_t value = _macSlots[slot];
+  if (role) {
+    *role = (uint8_t)(DICE_ROLE_A + (value & 3));
+  }
+  return (int)(value >> 2);
+}
+
+size_t DiceConfigCatalog::bytesPerEntry() {
+  return sizeof(float) + sizeof(uint32_t) + DICE_COLOR_COUNT * sizeof(uint16_t) + 3 * 6 +
+         sizeof(int8_t) + 2 * sizeof(uint8_t);
+}
+
+// diceId is a char[16] that need not be terminated
+bool DiceConfigCatalog::assignId(size_t index, const DiceConfig& config) {
+  char id[sizeof(config.diceId) + 1];
+  memcpy(id, config.diceId, sizeof(config.diceId));
+  id[sizeof(config.diceId)] = '\0';
+  if (!_ids.assign(index, id)) {
+    return fail("diceId arena full");
+  }
+  return true;
+}
+
+void DiceConfigCatalog::store(size_t index, const DiceConfig& config) {
+  memcpy(_macs[index][0], config.deviceA_mac, 6);
+  memcpy(_macs[index][1], config.deviceB1_mac, 6);
+  memcpy(_macs[index][2], config.deviceB2_mac, 6);
+  _colors[index][DICE_COLOR_X_BACKGROUND] = config.x_background;
+  _colors[index][DICE_COLOR_Y_BACKGROUND] = config.y_background;
+  _colors[index][DICE_COLOR_Z_BACKGROUND] = config.z_background;
+  _colors[index][DICE_COLOR_ENTANG_AB1] = config.entang_ab1_color;
+  _colors[index][DICE_COLOR_ENTANG_AB2] = config.entang_ab2_color;
+  _rssiLimits[index] = config.rssiLimit;
+  _flags[index] = (config.isSMD ? DICE_FLAG_SMD : 0) |
+                  (config.isNano ? DICE_FLAG_NANO : 0) |
+                  (config.alwaysSeven ? DICE_FLAG_ALWAYS_SEVEN : 0);
+  _switchPoints[index] = config.randomSwitchPoint;
+  _tumbleConstants[index] = config.tumbleConstant;
+  _sleepTimeouts[index] = config.deepSleepTimeout;
+}
+
+void DiceConfigCatalog::move(size_t to, size_t from) {
+  memcpy(_macs[to], _macs[from], sizeof(_macs[0]));
+  memcpy(_colors[to], _colors[from], sizeof(_colors[0]));
+  _rssiLimits[to] = _rssiLimits[from];
+  _flags[to] = _flags[from];
+  _switchPoints[to] = _switchPoints[from];
+  _tumbleConstants[to] = _tumbleConstants[from];
+  _sleepTimeouts[to] = _sleepTimeouts[from];
+}
+
+uint64_t DiceConfigCatalog::packMac(const uint8_t* mac) {
+  return (uint64_t)mac[0] << 40 | (uint64_t)mac[1] << 32 | (uint32_t)mac[2] << 24 |
+         (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+}
+
+// Fibonacci hashing: the multiply mixes the vendor bytes into the low
+// NIC bytes, which is where fleet MACs differ
+uint32_t DiceConfigCatalog::macHome(uint64_t key) const {
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & _macMask;
+}
+
+// Linear probing; the slot holding key, or -1
+long DiceConfigCatalog::findMacSlot(uint64_t key) const {
+  uint32_t slot = macHome(key);
+  uint32_t value;
+  while ((value = _macSlots[slot]) != MAC_EMPTY) {
+    if (packMac(_macs[value >> 2][value & 3]) == key) {
+      return (long)slot;
+    }
+    slot = (slot + 1) & _macMask;
+  }
+  return -1;
+}
+
+// No MAC of config may belong to another entry than owner
+bool DiceConfigCatalog::macsAvailable(const DiceConfig& config, long owner) {
+  const uint8_t* macs[3] = { config.deviceA_mac, config.deviceB1_mac, config.deviceB2_mac };
+  for (int r = 0; r < 3; r++) {
+    uint64_t key = packMac(macs[r]);
+    long slot = key != 0 ? findMacSlot(key) : -1;
+    if (slot >= 0 && (long)(_macSlots[slot] >> 2) != owner) {
+      return fail("MAC already belongs to another catalog entry");
+    }
+  }
+  return true;
+}
+
+// A MAC listed twice in one entry is indexed under its first role
+void DiceConfigCatalog::indexMacs(size_t index) {
+  for (uint32_t r = 0; r < 3; r++) {
+    uint64_t key = packMac(_macs[index][r]);
+    if (key == 0 || findMacSlot(key) >= 0) {
+      continue;
+    }
+    uint32_t slot = macHome(key);
+    while (_macSlots[slot] != MAC_EMPTY) {
+      slot = (slot + 1) & _macMask;
+    }
+    _macSlots[slot] = (uint32_t)index << 2 | r;
+  }
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+void DiceConfigCatalog::unindexMacs(size_t index) {
+  for (uint32_t r = 0; r < 3; r++) {
+    long found = findMacSlot(packMac(_macs[index][r]));
+    if (found < 0 || (_macSlots[found] >> 2) != index) {
+      continue;
+    }
+    uint32_t hole = (uint32_t)found;
+    uint32_t slot = hole;
+    for (;;) {
+      slot = (slot + 1) & _macMask;
+      uint32_t value = _macSlots[slot];
+      if (value == MAC_EMPTY) {
+        break;
+      }
+      // Move it back unless its home lies cyclically in (hole, slot]
+      uint32_t home = macHome(packMac(_macs[value >> 2][value & 3]));
+      if (((slot - home) & _macMask) >= ((slot - hole) & _macMask)) {
+        _macSlots[hole] = value;
+        hole = slot;
+      }
+    }
+    _macSlots[hole] = MAC_EMPTY;
+  }
+}
+
+bool DiceConfigCatalog::fail(const char* error) {
+  _lastError = error;
+  return false;
+}
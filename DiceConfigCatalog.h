@@ -0,0 +1,172 @@
+/*
+ * DiceConfigCatalog - Configs of many dice in struct-of-arrays form
+ * For hubs and gateways that track a whole fleet. Each field lives in its
+ * own dense array inside one allocation, so a scan over one field (all
+ * MACs, all RSSI limits) only touches that field's cache lines, and an
+ * entry costs bytesPerEntry() (39) bytes plus its diceId instead of a
+ * DiceConfigManager. diceIds are interned in a DiceIdIndex, which also
+ * answers findById() and prefix searches with binary searches.
+ * findByMac() goes through an open-addressing hash table on the packed
+ * 48-bit MAC, kept up to date by add(), set() and remove(). Its slots
+ * only hold entry and role (4 bytes); the key is checked against the MAC
+ * column, so the table costs 4 bytes per slot at most 3/4 full.
+ * Not thread-safe; guard it like any other container.
+ */
+
+#ifndef DICE_CONFIG_CATALOG_H
+#define DICE_CONFIG_CATALOG_H
+
+#include "DiceConfigPlatform.h"
+#include "DiceConfigParser.h"
+#include "DiceConfigStorage.h"
+#include "DiceConfigPattern.h"
+#include "DiceConfigMacIndex.h"
+#include "DiceConfigIdIndex.h"
+#include "DiceConfigManifest.h"
+
+// diceId arena bytes per entry when begin() isn't given a size
+#ifndef DICE_CONFIG_CATALOG_ID_BYTES
+#define DICE_CONFIG_CATALOG_ID_BYTES 8
+#endif
+
+// Color columns, in DiceConfig order
+enum DiceCatalogColor {
+  DICE_COLOR_X_BACKGROUND,
+  DICE_COLOR_Y_BACKGROUND,
+  DICE_COLOR_Z_BACKGROUND,
+  DICE_COLOR_ENTANG_AB1,
+  DICE_COLOR_ENTANG_AB2,
+  DICE_COLOR_COUNT
+};
+
+// Bits of flags()
+enum DiceCatalogFlag {
+  DICE_FLAG_SMD          = 1 << 0,
+  DICE_FLAG_NANO         = 1 << 1,
+  DICE_FLAG_ALWAYS_SEVEN = 1 << 2
+};
+
+class DiceConfigCatalog {
+public:
+  DiceConfigCatalog();
+  ~DiceConfigCatalog();
+
+  // Allocate room for capacity dice (one block for columns and MAC
+  // table) and idBytes of diceId text (0: DICE_CONFIG_CATALOG_ID_BYTES
+  // per dice)
+  bool begin(size_t capacity, size_t idBytes = 0);
+  void end();
+  void clear();
+
+  size_t size() const { return _size; }
+  size_t capacity() const { return _capacity; }
+
+  // Append a config that passes validate(); returns its index or -1.
+  // A MAC may belong to one entry only, and the diceId must fit the arena.
+  int add(const DiceConfig& config);
+
+  // Replace entry index (same rules as add())
+  bool set(size_t index, const DiceConfig& config);
+
+  // Remove entry index; the last entry moves into its place
+  bool remove(size_t index);
+
+  // Reassemble entry index as a DiceConfig (checksum recomputed)
+  bool get(size_t index, DiceConfig& config) const;
+
+  // Parse one file (library defaults + file, like dice_config_compile)
+  // and add it
+  bool loadFile(DiceConfigStorage& storage, const char* path);
+
+  // Add every file matching patterns, walking storage like auto-detection
+  // does. Returns the number added; files that can't be read, fail
+  // validate() or don't fit are counted in getFailedCount().
+  size_t loadDirectory(DiceConfigStorage& storage, const DicePatternSet& patterns);
+
+  // Add every section of a fleet manifest in one sequential pass. Same
+  // return value and failure counting as loadDirectory().
+  size_t loadManifest(DiceConfigStorage& storage, const char* manifestPath);
+
+  // Binary search by diceId; -1 if absent
+  int findById(const char* diceId) const { return _ids.find(diceId); }
+
+  // Entries whose diceId starts with prefix, in diceId order: returns the
+  // count, entries are getIds().entryAt(first) ... entryAt(first + count - 1)
+  size_t findByIdPrefix(const char* prefix, size_t& first) const {
+    return _ids.findPrefix(prefix, first);
+  }
+
+  // Hash lookup of a deviceA/B1/B2 MAC; -1 if absent (or all zero)
+  int findByMac(const uint8_t* mac, uint8_t* role = nullptr) const;
+
+  // Fields of entry index (no bounds checks)
+  const char* diceId(size_t index) const { return _ids.id(index); }
+  const uint8_t* mac(size_t index, uint8_t role) const { return _macs[index][role - DICE_ROLE_A]; }
+  uint16_t color(size_t index, uint8_t color) const { return _colors[index][color]; }
+  int8_t rssiLimit(size_t index) const { return _rssiLimits[index]; }
+  uint8_t flags(size_t index) const { return _flags[index]; }
+  uint8_t randomSwitchPoint(size_t index) const { return _switchPoints[index]; }
+  float tumbleConstant(size_t index) const { return _tumbleConstants[index]; }
+  uint32_t deepSleepTimeout(size_t index) const { return _sleepTimeouts[index]; }
+
+  // Whole columns, size() entries each, for scans
+  const uint8_t (*macs() const)[3][6] { return _macs; }
+  const uint16_t (*colors() const)[DICE_COLOR_COUNT] { return _colors; }
+  const int8_t* rssiLimits() const { return _rssiLimits; }
+  const uint8_t* flagColumn() const { return _flags; }
+  const DiceIdIndex& getIds() const { return _ids; }
+
+  size_t getFailedCount() const { return _failed; }
+  const char* getLastError() const { return _lastError; }
+
+  // Column bytes per entry
+  static size_t bytesPerEntry();
+
+  // Bytes allocated by begin()
+  size_t memoryUsage() const { return _blockSize + _ids.memoryUsage(); }
+
+private:
+  // Columns, widest alignment first; all point into _block
+  float* _tumbleConstants;
+  uint32_t* _sleepTimeouts;
+  uint16_t (*_colors)[DICE_COLOR_COUNT];
+  uint8_t (*_macs)[3][6];
+  int8_t* _rssiLimits;
+  uint8_t* _flags;
+  uint8_t* _switchPoints;
+
+  // MAC table: entry << 2 | role column, MAC_EMPTY if free
+  static const uint32_t MAC_EMPTY = 0xFFFFFFFFUL;
+  uint32_t* _macSlots;
+  uint32_t _macMask;
+
+  DiceIdIndex _ids;
+
+  void* _block;
+  size_t _blockSize;
+  size_t _size;
+  size_t _capacity;
+  size_t _failed;
+  const char* _lastError;
+
+  bool assignId(size_t index, const DiceConfig& config);
+  void store(size_t index, const DiceConfig& config);
+  void move(size_t to, size_t from);
+
+  static uint64_t packMac(const uint8_t* mac);
+  uint32_t macHome(uint64_t key) const;
+  long findMacSlot(uint64_t key) const;
+  bool macsAvailable(const DiceConfig& config, long owner);
+  void indexMacs(size_t index);
+  void unindexMacs(size_t index);
+  bool fail(const char* error);
+
+  static void visitFile(const char* path, int priority, const DiceFileInfo& info, void* context);
+  static void visitSection(const char* name, const DiceConfig& config, void* context);
+
+  // Not copyable (owns _block)
+  DiceConfigCatalog(const DiceConfigCatalog&);
+  DiceConfigCatalog& operator=(const DiceConfigCatalog&);
+};
+
+#endif // DICE_CONFIG_CATALOG_H
@@ -0,0 +1,185 @@
+/*
+ * DiceConfigHmac - Implementation
+ */
+
+#include "DiceConfigHmac.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+
+DiceConfigHmac::DiceConfigHmac() {
+  mbedtls_md_init(&_ctx);
+}
+
+DiceConfigHmac::~DiceConfigHmac() {
+  mbedtls_md_free(&_ctx);
+}
+
+void DiceConfigHmac::begin(const uint8_t* key, size_t keyLen) {
+  mbedtls_md_free(&_ctx);
+  mbedtls_md_init(&_ctx);
+  mbedtls_md_setup(&_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+  mbedtls_md_hmac_starts(&_ctx, key, keyLen);
+}
+
+void DiceConfigHmac::update(const void* data, size_t len) {
+  mbedtls_md_hmac_update(&_ctx, (const unsigned char*)data, len);
+}
+
+void DiceConfigHmac::finish(uint8_t* mac) {
+  mbedtls_md_hmac_finish(&_ctx, mac);
+}
+
+#else
+
+static const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+DiceConfigHmac::DiceConfigHmac() {
+  memset(_outerKey, 0, sizeof(_outerKey));
+  shaBegin(_inner);
+}
+
+DiceConfigHmac::~DiceConfigHmac() {
+  memset(_outerKey, 0, sizeof(_outerKey));
+}
+
+void DiceConfigHmac::begin(const uint8_t* key, size_t keyLen) {
+  uint8_t block[64];
+  memset(block, 0, sizeof(block));
+  
+  // Keys longer than the block size are hashed first
+  if (keyLen > sizeof(block)) {
+    Sha256 keySha;
+    shaBegin(keySha);
+    shaUpdate(keySha, key, keyLen);
+    shaFinish(keySha, block);
+  } else {
+    memcpy(block, key, keyLen);
+  }
+  
+  uint8_t innerKey[64];
+  for (size_t i = 0; i < sizeof(block); i++) {
+    innerKey[i] = block[i] ^ 0x36;
+    _outerKey[i] = block[i] ^ 0x5c;
+  }
+  
+  shaBegin(_inner);
+  shaUpdate(_inner, innerKey, sizeof(innerKey));
+  memset(block, 0, sizeof(block));
+  memset(innerKey, 0, sizeof(innerKey));
+}
+
+void DiceConfigHmac::update(const void* data, size_t len) {
+  shaUpdate(_inner, (const uint8_t*)data, len);
+}
+
+void DiceConfigHmac::finish(uint8_t* mac) {
+  uint8_t innerDigest[32];
+  shaFinish(_inner, innerDigest);
+  
+  Sha256 outer;
+  shaBegin(outer);
+  shaUpdate(outer, _outerKey, sizeof(_outerKey));
+  shaUpdate(outer, innerDigest, sizeof(innerDigest));
+  shaFinish(outer, mac);
+}
+
+void DiceConfigHmac::shaBegin(Sha256& sha) {
+  static const uint32_t initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(sha.state, initial, sizeof(initial));
+  sha.length = 0;
+  sha.used = 0;
+}
+
+void DiceConfigHmac::shaUpdate(Sha256& sha, const uint8_t* data, size_t len) {
+  sha.length += len;
+  
+  // Top up a partial block first
+  if (sha.used > 0) {
+    size_t take = 64 - sha.used;
+    if (take > len) take = len;
+    memcpy(sha.buffer + sha.used, data, take);
+    sha.used += take;
+    data += take;
+    len -= take;
+    if (sha.used < 64) return;
+    shaBlock(sha, sha.buffer);
+    sha.used = 0;
+  }
+  
+  while (len >= 64) {
+    shaBlock(sha, data);
+    data += 64;
+    len -= 64;
+  }
+  
+  memcpy(sha.buffer, data, len);
+  sha.used = len;
+}
+
+void DiceConfigHmac::shaFinish(Sha256& sha, uint8_t* digest) {
+  uint64_t bits = sha.length * 8;
+  
+  sha.buffer[sha.used++] = 0x80;
+  if (sha.used > 56) {
+    memset(sha.buffer + sha.used, 0, 64 - sha.used);
+    shaBlock(sha, sha.buffer);
+    sha.used = 0;
+  }
+  memset(sha.buffer + sha.used, 0, 56 - sha.used);
+  for (int i = 0; i < 8; i++) {
+    sha.buffer[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+  }
+  shaBlock(sha, sha.buffer);
+  
+  for (int i = 0; i < 8; i++) {
+    digest[4 * i] = (uint8_t)(sha.state[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(sha.state[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(sha.state[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)sha.state[i];
+  }
+}
+
+void DiceConfigHmac::shaBlock(Sha256& sha, const uint8_t* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+           ((uint32_t)block[4 * i + 2] << 8) | (uint32_t)block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  
+  uint32_t a = sha.state[0], b = sha.state[1], c = sha.state[2], d = sha.state[3];
+  uint32_t e = sha.state[4], f = sha.state[5], g = sha.state[6], h = sha.state[7];
+  
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  
+  sha.state[0] += a; sha.state[1] += b; sha.state[2] += c; sha.state[3] += d;
+  sha.state[4] += e; sha.state[5] += f; sha.state[6] += g; sha.state[7] += h;
+}
+
+#endif
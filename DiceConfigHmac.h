@@ -0,0 +1,54 @@
+/*
+ * DiceConfigHmac - Incremental HMAC-SHA256 for signed config files
+ * Uses mbedTLS (hardware SHA on ESP32) on target, a software SHA-256 elsewhere
+ */
+
+#ifndef DICE_CONFIG_HMAC_H
+#define DICE_CONFIG_HMAC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ESP_PLATFORM)
+#include "mbedtls/md.h"
+#endif
+
+#define DICE_HMAC_SIZE 32
+
+class DiceConfigHmac {
+public:
+  DiceConfigHmac();
+  ~DiceConfigHmac();
+  
+  // Start a new MAC with the given key
+  void begin(const uint8_t* key, size_t keyLen);
+  
+  // Feed message bytes (may be called any number of times)
+  void update(const void* data, size_t len);
+  
+  // Produce the 32-byte MAC
+  void finish(uint8_t* mac);
+
+private:
+#if defined(ESP_PLATFORM)
+  mbedtls_md_context_t _ctx;
+#else
+  // Minimal SHA-256 state for host builds
+  struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[64];
+    size_t used;
+  };
+  
+  Sha256 _inner;
+  uint8_t _outerKey[64];
+  
+  static void shaBegin(Sha256& sha);
+  static void shaUpdate(Sha256& sha, const uint8_t* data, size_t len);
+  static void shaFinish(Sha256& sha, uint8_t* digest);
+  static void shaBlock(Sha256& sha, const uint8_t* block);
+#endif
+};
+
+#endif // DICE_CONFIG_HMAC_H
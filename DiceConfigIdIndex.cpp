@@ -0,0 +1,210 @@
+/*
+ * DiceConfigIdIndex - Interned diceIds with a sorted index
+ */
+
+#include "DiceConfigIdIndex.h"
+
+DiceIdIndex::DiceIdIndex()
+  : _arena(nullptr), _arenaSize(0), _arenaUsed(0), _garbage(0), _offsets(nullptr),
+    _sorted(nullptr), _count(0), _capacity(0) {
+}
+
+DiceIdIndex::~DiceIdIndex() {
+  end();
+}
+
+bool DiceIdIndex::begin(size_t capacity, size_t arenaBytes) {
+  end();
+
+  if (capacity == 0 || arenaBytes == 0 || arenaBytes > 0xFFFFFFFFUL ||
+      capacity > (SIZE_MAX - arenaBytes) / (2 * sizeof(uint32_t))) {
+    return false;
+  }
+  uint8_t* block = (uint8_t*)malloc(capacity * 2 * sizeof(uint32_t) + arenaBytes);
+  if (block == nullptr) {
+    return false;
+  }
+
+  _offsets = (uint32_t*)block;
+  _sorted = _offsets + capacity;
+  _arena = (char*)(_sorted + capacity);
+  _arenaSize = arenaBytes;
+  _capacity = capacity;
+  return true;
+}
+
+void DiceIdIndex::end() {
+  free(_offsets);
+  _offsets = nullptr;
+  _sorted = nullptr;
+  _arena = nullptr;
+  _arenaSize = 0;
+  _capacity = 0;
+  clear();
+}
+
+void DiceIdIndex::clear() {
+  _arenaUsed = 0;
+  _garbage = 0;
+  _count = 0;
+}
+
+bool DiceIdIndex::assign(size_t entry, const char* id) {
+  bool replacing = entry < _count;
+  if (entry > _count || (!replacing && _count == _capacity)) {
+    return false;
+  }
+  if (replacing && strcmp(this->id(entry), id) == 0) {
+    return true;
+  }
+
+  // Check for room before touching anything; an id that is already
+  // interned needs none, the old id may free some
+  size_t first;
+  size_t needed = equalRange(id, first) > 0 ? 0 : strlen(id) + 1;
+  size_t freed = 0;
+  if (replacing && equalRange(this->id(entry), first) == 1) {
+    freed = strlen(this->id(entry)) + 1;
+  }
+  if (needed > _arenaSize - _arenaUsed + _garbage + freed) {
+    return false;
+  }
+
+  if (replacing) {
+    release(entry);
+    _count--;
+  }
+
+  size_t equal = equalRange(id, first);
+  if (equal > 0) {
+    _offsets[entry] = _offsets[_sorted[first]];
+  } else {
+    if (needed > _arenaSize - _arenaUsed) {
+      compact();
+    }
+    memcpy(_arena + _arenaUsed, id, needed);
+    _offsets[entry] = (uint32_t)_arenaUsed;
+    _arenaUsed += needed;
+  }
+
+  // Behind the entries with the same id
+  size_t rank = first + equal;
+  memmove(_sorted + rank + 1, _sorted + rank, (_count - rank) * sizeof(_sorted[0]));
+  _sorted[rank] = (uint32_t)entry;
+  _count++;
+  return true;
+}
+
+void DiceIdIndex::remove(size_t entry) {
+  if (entry >= _count) {
+    return;
+  }
+  release(entry);
+  _count--;
+
+  // Renumber the last entry; its id and rank stay
+  if (entry != _count) {
+    _sorted[rankOf(_count)] = (uint32_t)entry;
+    _offsets[entry] = _offsets[_count];
+  }
+}
+
+int DiceIdIndex::find(const char* id) const {
+  size_t first;
+  return equalRange(id, first) > 0 ? (int)_sorted[first] : -1;
+}
+
+size_t DiceIdIndex::findPrefix(const char* prefix, size_t& first) const {
+  first = lowerBound(prefix);
+  return prefixEnd(prefix, strlen(prefix), first) - first;
+}
+
+size_t DiceIdIndex::memoryUsage() const {
+  return _capacity * 2 * sizeof(uint32_t) + _arenaSize;
+}
+
+// First rank whose id is not less than id
+size_t DiceIdIndex::lowerBound(const char* id) const {
+  size_t low = 0;
+  size_t high = _count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (strcmp(this->id(_sorted[mid]), id) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// From first (a lower bound of prefix), the ids with the prefix come
+// first: binary search for the end of that run
+size_t DiceIdIndex::prefixEnd(const char* prefix, size_t prefixLength, size_t first) const {
+  size_t low = first;
+  size_t high = _count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (strncmp(id(_sorted[mid]), prefix, prefixLength) == 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+size_t DiceIdIndex::equalRange(const char* id, size_t& first) const {
+  first = lowerBound(id);
+  size_t end = first;
+  while (end < _count && strcmp(this->id(_sorted[end]), id) == 0) {
+    end++;
+  }
+  return end - first;
+}
+
+size_t DiceIdIndex::rankOf(size_t entry) const {
+  size_t rank;
+  size_t equal = equalRange(id(entry), rank);
+  for (size_t end = rank + equal; rank < end; rank++) {
+    if (_sorted[rank] == entry) {
+      break;
+    }
+  }
+  return rank;
+}
+
+// Take entry out of the sorted array; its id becomes garbage if no
+// other entry shares it. _count is left to the caller.
+void DiceIdIndex::release(size_t entry) {
+  size_t first;
+  if (equalRange(id(entry), first) == 1) {
+    _garbage += strlen(id(entry)) + 1;
+  }
+  size_t rank = rankOf(entry);
+  memmove(_sorted + rank, _sorted + rank + 1, (_count - rank - 1) * sizeof(_sorted[0]));
+}
+
+// Slide the live ids down over the garbage, oldest first. An id is live
+// if the entries with that text point at this copy (there may be an
+// older, dead copy of the same text).
+void DiceIdIndex::compact() {
+  size_t write = 0;
+  size_t read = 0;
+  while (read < _arenaUsed) {
+    const char* text = _arena + read;
+    size_t length = strlen(text) + 1;
+    size_t first;
+    size_t equal = equalRange(text, first);
+    if (equal > 0 && _offsets[_sorted[first]] == read) {
+      memmove(_arena + write, text, length);
+      for (size_t rank = first; rank < first + equal; rank++) {
+        _offsets[_sorted[rank]] = (uint32_t)write;
+      }
+      write += length;
+    }
+    read += length;
+  }
+  _arenaUsed = write;
+  _garbage = 0;
+}
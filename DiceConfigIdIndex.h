@@ -0,0 +1,73 @@
+/*
+ * DiceConfigIdIndex - Interned diceIds with a sorted index
+ * The diceId column of DiceConfigCatalog. Each distinct id is stored once,
+ * NUL-terminated, in an arena; entries refer to it by offset. A second
+ * array keeps the entries sorted by id, so exact and prefix lookups are
+ * binary searches. An entry costs 8 bytes plus its share of the arena
+ * (a typical "BART1" takes 6 bytes, against 16 for a char[16] copy).
+ * Removed ids leave garbage in the arena; it is compacted in place when
+ * a new id doesn't fit otherwise.
+ */
+
+#ifndef DICE_CONFIG_ID_INDEX_H
+#define DICE_CONFIG_ID_INDEX_H
+
+#include "DiceConfigPlatform.h"
+
+class DiceIdIndex {
+public:
+  DiceIdIndex();
+  ~DiceIdIndex();
+
+  // Room for capacity entries and arenaBytes of id text
+  bool begin(size_t capacity, size_t arenaBytes);
+  void end();
+  void clear();
+
+  // Set the id of entry (entry == size() appends). Fails, changing
+  // nothing, when the arena can't take the id even after compaction.
+  bool assign(size_t entry, const char* id);
+
+  // Remove entry; the last entry moves into its place
+  void remove(size_t entry);
+
+  const char* id(size_t entry) const { return _arena + _offsets[entry]; }
+
+  // An entry with exactly this id (the first in id order), or -1
+  int find(const char* id) const;
+
+  // Ids starting with prefix occupy ranks [first, first + count);
+  // returns count. Ranks are positions in id order, see entryAt().
+  size_t findPrefix(const char* prefix, size_t& first) const;
+
+  // Entry at rank (0 = smallest id)
+  size_t entryAt(size_t rank) const { return _sorted[rank]; }
+
+  size_t size() const { return _count; }
+  size_t arenaSize() const { return _arenaSize; }
+  size_t arenaUsed() const { return _arenaUsed - _garbage; }
+  size_t memoryUsage() const;
+
+private:
+  char* _arena;
+  size_t _arenaSize;
+  size_t _arenaUsed;
+  size_t _garbage;            // Bytes of ids no entry refers to
+  uint32_t* _offsets;         // Per entry
+  uint32_t* _sorted;          // Entries in id order
+  size_t _count;
+  size_t _capacity;
+
+  size_t lowerBound(const char* id) const;
+  size_t prefixEnd(const char* prefix, size_t prefixLength, size_t first) const;
+  size_t equalRange(const char* id, size_t& first) const;
+  size_t rankOf(size_t entry) const;
+  void release(size_t entry);
+  void compact();
+
+  // Not copyable (owns its buffers)
+  DiceIdIndex(const DiceIdIndex&);
+  DiceIdIndex& operator=(const DiceIdIndex&);
+};
+
+#endif // DICE_CONFIG_ID_INDEX_H
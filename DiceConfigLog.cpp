@@ -0,0 +1,167 @@
+/*
+ * DiceConfigLog - Implementation
+ */
+
+#include "DiceConfigLog.h"
+
+// Format strings, indexed by DiceLogCode. Integer arguments always come
+// before the text argument.
+struct LogFormat {
+  const char* format;
+  uint8_t ints;
+  bool text;
+};
+
+static const LogFormat LOG_FORMATS[DICE_LOG_CODE_COUNT] = {
+  { "Error: %s", 0, true },
+  { "Storage mounted successfully", 0, false },
+  { "No config path specified, searching for config files...", 0, false },
+  { "Auto-detected config file: %s", 0, true },
+  { "No unique config file found, using defaults", 0, false },
+  { "Config file not loaded, using defaults", 0, false },
+  { "Config file touched but content unchanged", 0, false },
+  { "Line %ld: Invalid format (no '=')", 1, false },
+  { "Line %ld: Invalid MAC address format", 1, false },
+  { "Line %ld: Unknown key '%s'", 1, true },
+  { "Warning: Checksum validation failed!", 0, false },
+  { "Config loaded successfully (%ld us, signature check %ld us)", 2, false },
+  { "Config saved successfully", 0, false },
+  { "Configuration reset to defaults", 0, false },
+  { "Validation error: diceId is empty", 0, false },
+  { "Validation error: randomSwitchPoint > 100", 0, false },
+  { "Validation error: tumbleConstant <= 0", 0, false },
+  { "Validation error: checksum mismatch", 0, false },
+  { "Slot %ld confirmed as last-known-good", 1, false },
+  { "Rolled back to slot %ld", 1, false },
+  { "Slot %ld failed %ld boots, rolling back", 2, false },
+  { "Config restored from slot %ld", 1, false },
+  { "No valid config or slot, using defaults", 0, false },
+  { "New config stored in slot %ld (trial)", 1, false },
+  { "Failed to open root directory", 0, false },
+  { "Root is not a directory", 0, false },
+  { "Found config file: %s", 0, true },
+  { "No files matching the config patterns found", 0, false },
+  { "Error: Found %ld config files. Only one allowed.", 1, false },
+  { "Config stored in RTC memory (generation %ld)", 1, false },
+  { "Config restored from RTC memory (generation %ld)", 1, false },
+  { "No valid config in RTC memory, loading from flash", 0, false },
+  { "Using filesystem already mounted by the application", 0, false },
+  { "Config read from partition (record %ld)", 1, false },
+  { "Config written to partition (record %ld)", 1, false },
+  { "No valid config in partition, loading from filesystem", 0, false },
+  { "Config index up to date (%ld matching files)", 1, false },
+  { "Device MAC has role %ld in %s", 1, true },
+  { "Device MAC not found in the MAC index", 0, false },
+  { "Error: Device MAC appears in more than one config file", 0, false },
+  { "MAC index rebuilt (%ld entries)", 1, false },
+  { "MAC index is stale, rebuilding", 0, false },
+  { "Manifest index rebuilt: %s", 0, true }
+};
+
+DiceConfigLog::DiceConfigLog() {
+  for (uint32_t i = 0; i < DICE_CONFIG_LOG_SIZE; i++) {
+    _cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  _head.store(0, std::memory_order_relaxed);
+  _tail.store(0, std::memory_order_relaxed);
+  _dropped.store(0, std::memory_order_relaxed);
+}
+
+bool DiceConfigLog::push(uint8_t code, int32_t arg0, int32_t arg1,
+                         const char* text, const char* message) {
+  uint32_t pos = _head.load(std::memory_order_relaxed);
+  Cell* cell;
+  
+  // Claim a cell
+  for (;;) {
+    cell = &_cells[pos & (DICE_CONFIG_LOG_SIZE - 1)];
+    int32_t diff = (int32_t)(cell->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = _head.load(std::memory_order_relaxed);
+    }
+  }
+  
+  Record& record = cell->record;
+  record.code = code;
+  record.args[0] = arg0;
+  record.args[1] = arg1;
+  record.message = message;
+  record.text[0] = '\0';
+  if (text != nullptr) {
+    strncpy(record.text, text, sizeof(record.text) - 1);
+    record.text[sizeof(record.text) - 1] = '\0';
+  }
+  
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool DiceConfigLog::pop(Record& record) {
+  uint32_t pos = _tail.load(std::memory_order_relaxed);
+  Cell* cell;
+  
+  for (;;) {
+    cell = &_cells[pos & (DICE_CONFIG_LOG_SIZE - 1)];
+    int32_t diff = (int32_t)(cell->sequence.load(std::memory_order_acquire) - (pos + 1));
+    if (diff == 0) {
+      if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;  // Empty
+    } else {
+      pos = _tail.load(std::memory_order_relaxed);
+    }
+  }
+  
+  record = cell->record;
+  cell->sequence.store(pos + DICE_CONFIG_LOG_SIZE, std::memory_order_release);
+  return true;
+}
+
+size_t DiceConfigLog::drain(Print& out, size_t maxRecords) {
+  uint32_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+  if (dropped > 0) {
+    out.printf("(%u log records dropped)\n", (unsigned)dropped);
+  }
+  
+  size_t count = 0;
+  Record record;
+  while (count < maxRecords && pop(record)) {
+    if (record.code >= DICE_LOG_CODE_COUNT) {
+      continue;
+    }
+    
+    const LogFormat& format = LOG_FORMATS[record.code];
+    const char* text = record.message != nullptr ? record.message : record.text;
+    long a0 = record.args[0];
+    long a1 = record.args[1];
+    char line[64 + DICE_CONFIG_PATH_MAX];
+    
+    if (!format.text) {
+      snprintf(line, sizeof(line), format.format, a0, a1);
+    } else if (format.ints == 0) {
+      snprintf(line, sizeof(line), format.format, text);
+    } else if (format.ints == 1) {
+      snprintf(line, sizeof(line), format.format, a0, text);
+    } else {
+      snprintf(line, sizeof(line), format.format, a0, a1, text);
+    }
+    
+    out.println(line);
+    count++;
+  }
+  
+  return count;
+}
+
+uint32_t DiceConfigLog::getDropped() {
+  return _dropped.load(std::memory_order_relaxed);
+}
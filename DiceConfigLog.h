@@ -0,0 +1,107 @@
+/*
+ * DiceConfigLog - Deferred verbose logging for DiceConfigManager
+ * Records are compact (code + arguments) and pushed into a lock-free
+ * fixed-size ring; formatting and output happen later in drain().
+ */
+
+#ifndef DICE_CONFIG_LOG_H
+#define DICE_CONFIG_LOG_H
+
+#include "DiceConfigPlatform.h"
+#include <atomic>
+
+// Number of buffered records (power of two)
+#ifndef DICE_CONFIG_LOG_SIZE
+#define DICE_CONFIG_LOG_SIZE 32
+#endif
+
+static_assert((DICE_CONFIG_LOG_SIZE & (DICE_CONFIG_LOG_SIZE - 1)) == 0,
+              "DICE_CONFIG_LOG_SIZE must be a power of two");
+
+// Log message codes; format strings live in DiceConfigLog.cpp
+enum DiceLogCode {
+  DICE_LOG_ERROR,
+  DICE_LOG_MOUNTED,
+  DICE_LOG_SEARCHING,
+  DICE_LOG_AUTO_DETECTED,
+  DICE_LOG_NO_UNIQUE_FILE,
+  DICE_LOG_NOT_LOADED,
+  DICE_LOG_UNCHANGED,
+  DICE_LOG_LINE_NO_SEPARATOR,
+  DICE_LOG_LINE_BAD_MAC,
+  DICE_LOG_LINE_UNKNOWN_KEY,
+  DICE_LOG_CHECKSUM_FAILED,
+  DICE_LOG_LOADED,
+  DICE_LOG_SAVED,
+  DICE_LOG_DEFAULTS,
+  DICE_LOG_INVALID_ID,
+  DICE_LOG_INVALID_SWITCH_POINT,
+  DICE_LOG_INVALID_TUMBLE,
+  DICE_LOG_INVALID_CHECKSUM,
+  DICE_LOG_SLOT_CONFIRMED,
+  DICE_LOG_SLOT_ROLLED_BACK,
+  DICE_LOG_SLOT_BOOT_FAILURES,
+  DICE_LOG_SLOT_RESTORED,
+  DICE_LOG_SLOT_NONE,
+  DICE_LOG_SLOT_STORED,
+  DICE_LOG_ROOT_OPEN_FAILED,
+  DICE_LOG_ROOT_NOT_DIR,
+  DICE_LOG_FOUND_FILE,
+  DICE_LOG_NO_MATCH,
+  DICE_LOG_MULTIPLE_MATCHES,
+  DICE_LOG_RTC_STORED,
+  DICE_LOG_RTC_RESTORED,
+  DICE_LOG_RTC_MISMATCH,
+  DICE_LOG_MOUNT_SHARED,
+  DICE_LOG_PARTITION_RESTORED,
+  DICE_LOG_PARTITION_STORED,
+  DICE_LOG_PARTITION_EMPTY,
+  DICE_LOG_INDEX_HIT,
+  DICE_LOG_MAC_SELECTED,
+  DICE_LOG_MAC_NOT_FOUND,
+  DICE_LOG_MAC_AMBIGUOUS,
+  DICE_LOG_MAC_INDEX_BUILT,
+  DICE_LOG_MAC_INDEX_STALE,
+  DICE_LOG_MANIFEST_INDEXED,
+  DICE_LOG_CODE_COUNT
+};
+
+class DiceConfigLog {
+public:
+  DiceConfigLog();
+  
+  // Queue a record; never blocks. "text" is copied (a path fits whole),
+  // "message" must point to a string literal. Returns false if full.
+  bool push(uint8_t code, int32_t arg0 = 0, int32_t arg1 = 0,
+            const char* text = nullptr, const char* message = nullptr);
+  
+  // Format up to maxRecords queued records to out, one line each
+  size_t drain(Print& out, size_t maxRecords = DICE_CONFIG_LOG_SIZE);
+  
+  // Records lost because the ring was full
+  uint32_t getDropped();
+
+private:
+  struct Record {
+    const char* message;
+    int32_t args[2];
+    uint8_t code;
+    char text[DICE_CONFIG_PATH_MAX];
+  };
+  
+  // Bounded MPMC ring: each cell's sequence tells producers and the
+  // consumer whose turn it is, so no lock is needed on either side
+  struct Cell {
+    std::atomic<uint32_t> sequence;
+    Record record;
+  };
+  
+  Cell _cells[DICE_CONFIG_LOG_SIZE];
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _tail;
+  std::atomic<uint32_t> _dropped;
+  
+  bool pop(Record& record);
+};
+
+#endif // DICE_CONFIG_LOG_H
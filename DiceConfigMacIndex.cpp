@@ -0,0 +1,167 @@
+/*
+ * DiceConfigMacIndex - Sorted MAC -> config file index
+ */
+
+#include "DiceConfigMacIndex.h"
+
+static const uint32_t MACIDX_MAGIC = 0x44434D58UL;  // "DCMX"
+static const uint16_t MACIDX_VERSION = 1;
+
+DiceMacIndex::FindResult DiceMacIndex::find(DiceConfigStorage& storage, const char* indexPath,
+                                            const uint8_t* mac, DiceMacIndexRecord& record) {
+  DiceConfigStorage::File file;
+  if (!storage.open(file, indexPath, "r")) {
+    return NO_INDEX;
+  }
+
+  Header header;
+  if (!readHeader(file, header)) {
+    file.close();
+    return NO_INDEX;
+  }
+
+  // Lower bound of mac
+  size_t low = 0;
+  size_t high = header.count;
+  DiceMacIndexRecord probe;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (!file.seek(sizeof(header) + mid * sizeof(probe)) ||
+        file.read(&probe, sizeof(probe)) != (int)sizeof(probe)) {
+      file.close();
+      return NO_INDEX;
+    }
+    if (memcmp(probe.mac, mac, sizeof(probe.mac)) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  FindResult result = NOT_FOUND;
+  if (low < header.count && file.seek(sizeof(header) + low * sizeof(record)) &&
+      file.read(&record, sizeof(record)) == (int)sizeof(record) &&
+      memcmp(record.mac, mac, sizeof(record.mac)) == 0) {
+    result = FOUND;
+    record.path[sizeof(record.path) - 1] = '\0';
+
+    // Equal MACs are adjacent; another file with it makes the choice
+    // ambiguous. One file may hold the MAC in more than one role, so
+    // the whole run is checked.
+    for (size_t i = low + 1; i < header.count && result == FOUND; i++) {
+      if (file.read(&probe, sizeof(probe)) != (int)sizeof(probe) ||
+          memcmp(probe.mac, mac, sizeof(probe.mac)) != 0) {
+        break;
+      }
+      if (strncmp(probe.path, record.path, sizeof(probe.path)) != 0) {
+        result = AMBIGUOUS;
+      }
+    }
+  }
+
+  file.close();
+  return result;
+}
+
+bool DiceMacIndex::recordsFor(const char* path, const DiceConfig& config,
+                              DiceMacIndexRecord* records, size_t& count) {
+  static const uint8_t ZERO[6] = { 0, 0, 0, 0, 0, 0 };
+  const uint8_t* macs[3] = { config.deviceA_mac, config.deviceB1_mac, config.deviceB2_mac };
+
+  count = 0;
+  while (*path == '/') path++;
+  if (strlen(path) >= sizeof(records[0].path)) {
+    return false;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (memcmp(macs[i], ZERO, 6) == 0) {
+      continue;
+    }
+    DiceMacIndexRecord& record = records[count++];
+    memset(&record, 0, sizeof(record));
+    memcpy(record.mac, macs[i], 6);
+    record.role = (uint8_t)(DICE_ROLE_A + i);
+    strcpy(record.path, path);
+  }
+  return true;
+}
+
+bool DiceMacIndex::write(DiceConfigStorage& storage, const char* indexPath,
+                         DiceMacIndexRecord* records, size_t count, uint32_t sourceHash) {
+  qsort(records, count, sizeof(DiceMacIndexRecord), compareRecords);
+
+  DiceConfigStorage::File file;
+  if (!storage.open(file, indexPath, "w")) {
+    return false;
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MACIDX_MAGIC;
+  header.version = MACIDX_VERSION;
+  header.recordSize = sizeof(DiceMacIndexRecord);
+  header.count = (uint32_t)count;
+  header.sourceHash = sourceHash;
+
+  bool ok = file.write(&header, sizeof(header)) == sizeof(header) &&
+            (count == 0 ||
+             file.write(records, count * sizeof(DiceMacIndexRecord)) == count * sizeof(DiceMacIndexRecord));
+  file.close();
+  return ok;
+}
+
+bool DiceMacIndex::readSourceHash(DiceConfigStorage& storage, const char* indexPath, uint32_t& hash) {
+  DiceConfigStorage::File file;
+  if (!storage.open(file, indexPath, "r")) {
+    return false;
+  }
+  Header header;
+  bool ok = readHeader(file, header);
+  file.close();
+  hash = ok ? header.sourceHash : 0;
+  return ok;
+}
+
+uint32_t DiceMacIndex::fileHash(const char* path, uint32_t size) {
+  uint32_t hash = 2166136261UL;
+  while (*path == '/') path++;
+  for (; *path != '\0'; path++) {
+    hash = (hash ^ (uint8_t)*path) * 16777619UL;
+  }
+  for (int shift = 0; shift < 32; shift += 8) {
+    hash = (hash ^ (uint8_t)(size >> shift)) * 16777619UL;
+  }
+  return hash;
+}
+
+bool DiceMacIndex::readHeader(DiceConfigStorage::File& file, Header& header) {
+  return file.read(&header, sizeof(header)) == (int)sizeof(header) &&
+         header.magic == MACIDX_MAGIC && header.version == MACIDX_VERSION &&
+         header.recordSize == sizeof(DiceMacIndexRecord) &&
+         file.size() == sizeof(header) + (size_t)header.count * sizeof(DiceMacIndexRecord);
+}
+
+uint8_t DiceMacIndex::roleOf(const DiceConfig& config, const uint8_t* mac) {
+  if (memcmp(config.deviceA_mac, mac, 6) == 0) return DICE_ROLE_A;
+  if (memcmp(config.deviceB1_mac, mac, 6) == 0) return DICE_ROLE_B1;
+  if (memcmp(config.deviceB2_mac, mac, 6) == 0) return DICE_ROLE_B2;
+  return DICE_ROLE_NONE;
+}
+
+// By MAC, then path, then role, so the file is byte-identical for the
+// same set of configs no matter in which order they were found
+int DiceMacIndex::compare(const DiceMacIndexRecord& a, const DiceMacIndexRecord& b) {
+  int result = memcmp(a.mac, b.mac, sizeof(a.mac));
+  if (result == 0) {
+    result = strncmp(a.path, b.path, sizeof(a.path));
+  }
+  if (result == 0) {
+    result = (int)a.role - (int)b.role;
+  }
+  return result;
+}
+
+int DiceMacIndex::compareRecords(const void* a, const void* b) {
+  return compare(*(const DiceMacIndexRecord*)a, *(const DiceMacIndexRecord*)b);
+}
@@ -0,0 +1,92 @@
+/*
+ * DiceConfigMacIndex - Sorted MAC -> config file index
+ * One file per dice set on a shared filesystem image; each device finds
+ * its own by looking up its MAC. The index is a header followed by
+ * fixed-size records sorted by MAC, so a lookup is a binary search of
+ * seeks and 64-byte reads: cost grows with log2 of the number of configs.
+ * Build it on the host with extras/tools/dice_config_macindex, or let
+ * DiceConfigManager build it on the device (small fleets).
+ */
+
+#ifndef DICE_CONFIG_MAC_INDEX_H
+#define DICE_CONFIG_MAC_INDEX_H
+
+#include "DiceConfigPlatform.h"
+#include "DiceConfigParser.h"
+#include "DiceConfigStorage.h"
+
+#ifndef DICE_CONFIG_MACIDX_PATH
+#define DICE_CONFIG_MACIDX_PATH "/.dcm_macidx"
+#endif
+
+// Records the device may hold in RAM when it rebuilds the index itself
+#ifndef DICE_CONFIG_MACIDX_BUILD_MAX
+#define DICE_CONFIG_MACIDX_BUILD_MAX 192
+#endif
+
+// Which MAC field of the config matched the device
+enum DiceDeviceRole {
+  DICE_ROLE_NONE,
+  DICE_ROLE_A,
+  DICE_ROLE_B1,
+  DICE_ROLE_B2
+};
+
+struct DiceMacIndexRecord {
+  uint8_t mac[6];
+  uint8_t role;               // DiceDeviceRole
+  uint8_t reserved;
+  char path[56];              // Relative to the root, NUL-terminated
+};
+
+class DiceMacIndex {
+public:
+  enum FindResult {
+    FOUND,
+    NOT_FOUND,
+    AMBIGUOUS,                // Same MAC in more than one file
+    NO_INDEX                  // Missing or unreadable index
+  };
+
+  // Binary search for mac
+  static FindResult find(DiceConfigStorage& storage, const char* indexPath,
+                         const uint8_t* mac, DiceMacIndexRecord& record);
+
+  // Records for one config file (one per non-zero MAC, up to 3) and
+  // their count. False, with no records, if path doesn't fit a record.
+  static bool recordsFor(const char* path, const DiceConfig& config,
+                         DiceMacIndexRecord* records, size_t& count);
+
+  // Sort records in place and write the index. sourceHash identifies
+  // the set of files it was built from (see fileHash()).
+  static bool write(DiceConfigStorage& storage, const char* indexPath,
+                    DiceMacIndexRecord* records, size_t count, uint32_t sourceHash);
+
+  // sourceHash of an existing index
+  static bool readSourceHash(DiceConfigStorage& storage, const char* indexPath, uint32_t& hash);
+
+  // Order-independent fingerprint of a set of files: sum the results.
+  // Path and size only; mtimes don't survive building a filesystem image.
+  // begin() rebuilds once on a miss to catch edits that keep the size.
+  static uint32_t fileHash(const char* path, uint32_t size);
+
+  // Role of mac in config, or DICE_ROLE_NONE
+  static uint8_t roleOf(const DiceConfig& config, const uint8_t* mac);
+
+  static int compare(const DiceMacIndexRecord& a, const DiceMacIndexRecord& b);
+
+private:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t count;
+    uint32_t sourceHash;
+  };
+
+  static bool readHeader(DiceConfigStorage::File& file, Header& header);
+
+  static int compareRecords(const void* a, const void* b);
+};
+
+#endif // DICE_CONFIG_MAC_INDEX_H
@@ -4,59 +4,251 @@
 
 #include "DiceConfigManager.h"
 
+#if defined(ESP_PLATFORM)
+#if __has_include(<esp_mac.h>)
+#include <esp_mac.h>
+#else
+#include <esp_system.h>
+#endif
+#endif
+
+// FNV-1a parameters used for config content fingerprints
+static const uint32_t FNV_OFFSET_BASIS = 2166136261UL;
+static const uint32_t FNV_PRIME = 16777619UL;
+
+// A/B slot files
+static const char* SLOT_STATE_PATH = "/.dcm_slots";
+static const char* SLOT_IMAGE_PATHS[2] = { "/.dcm_slot0", "/.dcm_slot1" };
+static const uint32_t SLOT_IMAGE_MAGIC = 0x44434D31UL;  // "DCM1"
+static const uint32_t SLOT_STATE_MAGIC = 0x44435331UL;  // "DCS1"
+
+// Auto-detection index file
+static const uint32_t INDEX_MAGIC = 0x44434931UL;       // "DCI1"
+static const uint16_t INDEX_VERSION = 3;
+
+// Recursive writer lock held while the config is modified
+class DiceConfigManager::WriteGuard {
+public:
+  explicit WriteGuard(DiceConfigManager& manager) : _manager(manager) {
+    _manager.lockWriter();
+  }
+  
+  ~WriteGuard() {
+    _manager.unlockWriter();
+  }
+
+private:
+  DiceConfigManager& _manager;
+};
+
 // Constructor
 DiceConfigManager::DiceConfigManager() {
   _verbose = false;
   _lastError[0] = '\0';
   strcpy(_configPath, "/config.txt");
+  _loadedValid = false;
+  _loadedPathHash = 0;
+  _loadedSize = 0;
+  _loadedWriteTime = 0;
+  _loadedContentHash = 0;
+  _slotsEnabled = false;
+  _maxBootAttempts = 3;
+  memset(&_slotState, 0, sizeof(_slotState));
+  _rtcEnabled = false;
+  _rtcRestored = false;
+  _rtcGeneration = DICE_CONFIG_RTC_GENERATION;
+  _partitionEnabled = false;
+  memset(&_index, 0, sizeof(_index));
+  _indexValid = false;
+  _macSelection = false;
+  _macSelected = false;
+  _deviceMacSet = false;
+  memset(_deviceMac, 0, sizeof(_deviceMac));
+  _deviceRole = DICE_ROLE_NONE;
+  _formatOnFail = true;
+  _mountLogged = false;
+  _signingKeyLen = 0;
+  _lastLoadMicros = 0;
+  _lastAuthMicros = 0;
+  for (int i = 0; i < 2; i++) {
+    _snapshots[i].seq.store(0, std::memory_order_relaxed);
+  }
+  _publishIndex.store(0, std::memory_order_relaxed);
+  _generation.store(0, std::memory_order_relaxed);
+  _asyncPending = 0;
+  memset(_asyncOrder, 0, sizeof(_asyncOrder));
+  _asyncStop = false;
+  _asyncFailed = false;
+  memset(_asyncQueues, 0, sizeof(_asyncQueues));
+  _beginPath[0] = '\0';
+  _beginHasPath = false;
+  _beginRestored = false;
+  _asyncState.store(DICE_ASYNC_IDLE, std::memory_order_relaxed);
+  memset(_observers, 0, sizeof(_observers));
+  memset(_fieldSubscribers, 0, sizeof(_fieldSubscribers));
+  _changedFields = 0;
+  _unnotifiedFields = 0;
+  _writeDepth = 0;
+  _updateDepth = 0;
+#if defined(ESP_PLATFORM)
+  _writeLock = xSemaphoreCreateRecursiveMutex();
+  _asyncLock = xSemaphoreCreateMutex();
+  _asyncTask = nullptr;
+#else
+  _asyncStarted = false;
+#endif
+  DiceConfigParser::setDefaults(_baseConfig);
   initDefaultConfig();
+  _lastPublished = _config;
+  publish();
+}
+
+DiceConfigManager::~DiceConfigManager() {
+  stopAsyncWorker();
+#if defined(ESP_PLATFORM)
+  vSemaphoreDelete(_asyncLock);
+  vSemaphoreDelete(_writeLock);
+#endif
 }
 
-// Initialize LittleFS and optionally load config
+// Mount storage and optionally load config
 bool DiceConfigManager::begin(const char* configPath, bool formatOnFail) {
-  if (!LittleFS.begin(formatOnFail)) {
-    setError("LittleFS mount failed");
-    return false;
+  _formatOnFail = formatOnFail;
+  
+  // Waking from deep sleep: the validated config is still in RTC memory
+  if (_rtcEnabled && restoreFromRtc(configPath)) {
+    return true;
   }
   
-  if (_verbose) {
-    Serial.println("LittleFS mounted successfully");
+  if (_partitionEnabled && restoreFromPartition()) {
+    return true;
+  }
+  
+  return beginFromStorage(configPath);
+}
+
+// Publish something usable now and do the slow part on the worker
+bool DiceConfigManager::beginAsync(DiceConfigCallback callback, void* context,
+                                   const char* configPath, bool formatOnFail) {
+  _formatOnFail = formatOnFail;
+  
+  // A snapshot from RTC memory or the partition is already the
+  // validated config; the worker only reports it. A real begin that is
+  // still pending reports its own result instead.
+  if ((_rtcEnabled && restoreFromRtc(configPath)) ||
+      (_partitionEnabled && restoreFromPartition())) {
+    if (callback == nullptr) {
+      return true;
+    }
+    lockAsync();
+    if ((_asyncPending & ASYNC_BEGIN) == 0) {
+      _beginRestored = true;
+    }
+    unlockAsync();
+    return queueAsync(ASYNC_BEGIN, callback, context);
+  }
+  
+  lockAsync();
+  _beginRestored = false;
+  _beginHasPath = configPath != nullptr;
+  if (_beginHasPath) {
+    strncpy(_beginPath, configPath, sizeof(_beginPath) - 1);
+    _beginPath[sizeof(_beginPath) - 1] = '\0';
+  }
+  unlockAsync();
+  
+  return queueAsync(ASYNC_BEGIN, callback, context);
+}
+
+bool DiceConfigManager::beginInBackground() {
+  WriteGuard guard(*this);
+  
+  lockAsync();
+  char path[sizeof(_beginPath)];
+  bool hasPath = _beginHasPath;
+  bool restored = _beginRestored;
+  _beginRestored = false;
+  strcpy(path, _beginPath);
+  unlockAsync();
+  
+  if (restored) {
+    return true;
+  }
+  
+  // Hold back intermediate publishes (defaults, slot fallbacks) so
+  // readers see one switch from the boot config to the final one
+  _updateDepth++;
+  bool success = beginFromStorage(hasPath ? path : nullptr);
+  _updateDepth--;
+  publish();
+  return success;
+}
+
+bool DiceConfigManager::beginFromStorage(const char* configPath) {
+  // Mount now (or pick up an existing mount) so a broken filesystem
+  // still fails begin() instead of silently falling back to defaults
+  if (!ensureMounted()) {
+    return false;
   }
   
+  _macSelected = false;
+  _deviceRole = DICE_ROLE_NONE;
+  
   // If no explicit path provided, try auto-detection
   if (configPath == nullptr) {
-    if (_verbose) {
-      Serial.println("No config path specified, searching for *_config.txt...");
-    }
+    logEvent(DICE_LOG_SEARCHING);
     
-    if (findConfigFile(_configPath, sizeof(_configPath))) {
-      if (_verbose) {
-        Serial.printf("Auto-detected config file: %s\n", _configPath);
-      }
+    // Fleet image: the MAC index answers without a directory scan
+    if ((_macSelection && findConfigByMac(_configPath, sizeof(_configPath))) ||
+        findConfigFile(_configPath, sizeof(_configPath))) {
+      logEvent(DICE_LOG_AUTO_DETECTED, 0, 0, _configPath);
     } else {
       // No config file found or multiple found
-      if (_verbose) {
-        Serial.println("No unique config file found, using defaults");
-      }
+      logEvent(DICE_LOG_NO_UNIQUE_FILE);
       strcpy(_configPath, "/config.txt"); // Set default for save operations
+      if (_slotsEnabled) {
+        return beginFromSlots();
+      }
       setDefaults();
       return true; // Not a critical error
     }
   } else {
     // Explicit path provided
+    _indexValid = false;
     strncpy(_configPath, configPath, sizeof(_configPath) - 1);
     _configPath[sizeof(_configPath) - 1] = '\0';
   }
   
+  if (_slotsEnabled) {
+    return beginFromSlots();
+  }
+  
   // Try to load existing config, otherwise use defaults
-  if (!load()) {
-    if (_verbose) {
-      Serial.println("Config file not loaded, using defaults");
-    }
+  bool loaded = load();
+  
+  // A stale MAC index can point at a file that is gone or no longer
+  // ours: rebuild it and try once more
+  if (_macSelected && !(loaded && matchesDeviceMac())) {
+    logEvent(DICE_LOG_MAC_INDEX_STALE);
+    loaded = rebuildMacIndex() && findConfigByMac(_configPath, sizeof(_configPath)) &&
+             load() && matchesDeviceMac();
+  } else if (_macSelection && loaded) {
+    matchesDeviceMac();  // Found without the index: still report the role
+  }
+  
+  if (!loaded) {
+    logEvent(DICE_LOG_NOT_LOADED);
     setDefaults();
     return true; // Not a critical error
   }
   
+  updateIndexedDiceId();
+  
+  // First boot in partition mode: later boots skip the filesystem
+  if (_partitionEnabled) {
+    storeToPartition();
+  }
+  
   return true;
 }
 
@@ -66,326 +258,928 @@ bool DiceConfigManager::load() {
 }
 
 bool DiceConfigManager::load(const char* filename) {
-  File file = LittleFS.open(filename, "r");
-  if (!file) {
+  WriteGuard guard(*this);
+  
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, filename, "r")) {
     setError("Failed to open config file");
     return false;
   }
+  
+  size_t fileSize = file.size();
+  time_t writeTime = file.lastWrite();
+  uint32_t contentHash = 0;
+  bool success = parseFile(file, &contentHash);
+  file.close();
+  
+  // Remember what was loaded so reloadIfChanged() can skip unchanged files
+  _loadedValid = success;
+  _loadedPathHash = hashBytes(FNV_OFFSET_BASIS, filename, strlen(filename));
+  _loadedSize = fileSize;
+  _loadedWriteTime = writeTime;
+  _loadedContentHash = contentHash;
+  
+  // An RTC image from before this load must not come back on wake
+  if (success) {
+    DiceConfigRtc::invalidate();
+  }
+  
+  return success;
+}
 
-  char line[128];
-  int lineNum = 0;
-  bool success = true;
+// Index lookup, then one seek and a read bounded to the section
+bool DiceConfigManager::loadFromManifest(const char* manifestPath, const char* name) {
+  WriteGuard guard(*this);
   
-  while (file.available()) {
-    int len = file.readBytesUntil('\n', line, sizeof(line) - 1);
-    line[len] = '\0';
-    lineNum++;
-    
-    // Remove carriage return if present
-    if (len > 0 && line[len - 1] == '\r') {
-      line[len - 1] = '\0';
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  for (int attempt = 0; attempt < 2; attempt++) {
+    DiceConfigStorage::File file;
+    if (!_storage.open(file, manifestPath, "r")) {
+      setError("Failed to open manifest");
+      return false;
     }
     
-    trim(line);
-    
-    // Skip empty lines and comments
-    if (line[0] == '\0' || line[0] == '#') {
-      continue;
+    DiceManifestSection section;
+    DiceManifest::FindResult found =
+      DiceManifest::find(_storage, manifestPath, file.size(), file.lastWrite(), name, section);
+    if (found == DiceManifest::NOT_FOUND) {
+      file.close();
+      setError("Section not found in manifest");
+      return false;
     }
     
-    // Find the '=' separator
-    char* separator = strchr(line, '=');
-    if (!separator) {
-      if (_verbose) {
-        Serial.printf("Line %d: Invalid format (no '=')\n", lineNum);
+    // Both ends of the section confirm the index still matches the manifest
+    if (found == DiceManifest::FOUND && DiceManifest::checkEnd(file, section) &&
+        file.seek(section.offset) && DiceManifest::checkHeader(file, section)) {
+      bool success = parseFile(file, nullptr, section.length - section.headerLength,
+                               section.headerLength > 0 ? section.name : nullptr);
+      file.close();
+      _loadedValid = false;
+      if (success) {
+        DiceConfigRtc::invalidate();
       }
-      continue;
+      return success;
     }
+    file.close();
     
-    // Split into key and value
-    *separator = '\0';
-    char* key = line;
-    char* value = separator + 1;
-    
-    trim(key);
-    trim(value);
-    
-    // Parse based on key
-    if (strcmp(key, "diceId") == 0) {
-      strncpy(_config.diceId, value, sizeof(_config.diceId) - 1);
-      _config.diceId[sizeof(_config.diceId) - 1] = '\0';
-    }
-    else if (strcmp(key, "deviceA_mac") == 0) {
-      if (!parseMacAddress(value, _config.deviceA_mac)) {
-        if (_verbose) {
-          Serial.printf("Line %d: Invalid MAC address format\n", lineNum);
-        }
+    if (attempt == 0) {
+      if (!DiceManifest::buildIndex(_storage, manifestPath)) {
+        setError("Failed to write manifest index");
+        return false;
       }
+      logEvent(DICE_LOG_MANIFEST_INDEXED, 0, 0, manifestPath);
     }
-    else if (strcmp(key, "deviceB1_mac") == 0) {
-      parseMacAddress(value, _config.deviceB1_mac);
-    }
-    else if (strcmp(key, "deviceB2_mac") == 0) {
-      parseMacAddress(value, _config.deviceB2_mac);
-    }
-    else if (strcmp(key, "x_background") == 0) {
-      _config.x_background = (uint16_t)strtoul(value, NULL, 0);
-    }
-    else if (strcmp(key, "y_background") == 0) {
-      _config.y_background = (uint16_t)strtoul(value, NULL, 0);
-    }
-    else if (strcmp(key, "z_background") == 0) {
-      _config.z_background = (uint16_t)strtoul(value, NULL, 0);
-    }
-    else if (strcmp(key, "entang_ab1_color") == 0) {
-      _config.entang_ab1_color = (uint16_t)strtoul(value, NULL, 0);
-    }
-    else if (strcmp(key, "entang_ab2_color") == 0) {
-      _config.entang_ab2_color = (uint16_t)strtoul(value, NULL, 0);
-    }
-    else if (strcmp(key, "rssiLimit") == 0) {
-      _config.rssiLimit = (int8_t)atoi(value);
-    }
-    else if (strcmp(key, "isSMD") == 0) {
-      _config.isSMD = parseBool(value);
-    }
-    else if (strcmp(key, "isNano") == 0) {
-      _config.isNano = parseBool(value);
-    }
-    else if (strcmp(key, "alwaysSeven") == 0) {
-      _config.alwaysSeven = parseBool(value);
-    }
-    else if (strcmp(key, "randomSwitchPoint") == 0) {
-      _config.randomSwitchPoint = (uint8_t)atoi(value);
-    }
-    else if (strcmp(key, "tumbleConstant") == 0) {
-      _config.tumbleConstant = atof(value);
+  }
+  
+  setError("Manifest index does not match the manifest");
+  return false;
+}
+
+// Queue a load of the current config path on the background worker
+bool DiceConfigManager::loadAsync(DiceConfigCallback callback, void* context) {
+  return queueAsync(ASYNC_LOAD, callback, context);
+}
+
+// Queue a save of the current config on the background worker
+bool DiceConfigManager::saveAsync(DiceConfigCallback callback, void* context) {
+  return queueAsync(ASYNC_SAVE, callback, context);
+}
+
+DiceAsyncState DiceConfigManager::getAsyncState() {
+  return (DiceAsyncState)_asyncState.load(std::memory_order_acquire);
+}
+
+// Reload configuration only if the file changed since the last load
+bool DiceConfigManager::reloadIfChanged(bool* reloaded) {
+  WriteGuard guard(*this);
+  
+  if (reloaded) {
+    *reloaded = false;
+  }
+  
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, _configPath, "r")) {
+    setError("Failed to open config file");
+    return false;
+  }
+  
+  size_t fileSize = file.size();
+  time_t writeTime = file.lastWrite();
+  bool sameFile = _loadedValid &&
+                  _loadedPathHash == hashBytes(FNV_OFFSET_BASIS, _configPath, strlen(_configPath));
+  
+  // Fast path: size and last-write time unchanged
+  if (sameFile && fileSize == _loadedSize && writeTime != 0 && writeTime == _loadedWriteTime) {
+    file.close();
+    return true;
+  }
+  
+  // Metadata changed but size didn't: compare content hash before parsing
+  if (sameFile && fileSize == _loadedSize) {
+    uint32_t contentHash = hashFile(file);
+    if (contentHash == _loadedContentHash) {
+      _loadedWriteTime = writeTime;
+      file.close();
+      logEvent(DICE_LOG_UNCHANGED);
+      return true;
     }
-    else if (strcmp(key, "deepSleepTimeout") == 0) {
-      _config.deepSleepTimeout = strtoul(value, NULL, 0);
+    file.seek(0);
+  }
+  
+  uint32_t contentHash = 0;
+  bool success = parseFile(file, &contentHash);
+  file.close();
+  
+  _loadedValid = success;
+  _loadedPathHash = hashBytes(FNV_OFFSET_BASIS, _configPath, strlen(_configPath));
+  _loadedSize = fileSize;
+  _loadedWriteTime = writeTime;
+  _loadedContentHash = contentHash;
+  
+  if (reloaded) {
+    *reloaded = true;
+  }
+  return success;
+}
+
+// Parse an open config file, hashing (and authenticating) the raw lines
+// in the same pass. _config is only replaced if the whole file is accepted.
+bool DiceConfigManager::parseFile(DiceConfigStorage::File& file, uint32_t* contentHash,
+                                  size_t limit, const char* defaultId) {
+  char line[128];
+  int lineNum = 0;
+  bool success = true;
+  uint32_t hash = FNV_OFFSET_BASIS;
+  DiceConfig parsed = _config;
+  unsigned long startMicros = micros();
+  unsigned long authMicros = 0;
+  
+  bool signedMode = _signingKeyLen > 0;
+  bool haveSignature = false;
+  uint8_t signature[DICE_HMAC_SIZE];
+  DiceConfigHmac hmac;
+  if (signedMode) {
+    hmac.begin(_signingKey, _signingKeyLen);
+  }
+  
+  // Only a checksum written in the file itself is verified; keys the file
+  // doesn't set keep their current (e.g. base config) values
+  parsed.checksum = 0;
+  
+  // Manifest sections: the diceId defaults to the section name
+  if (defaultId) {
+    memset(parsed.diceId, 0, sizeof(parsed.diceId));
+    strncpy(parsed.diceId, defaultId, sizeof(parsed.diceId) - 1);
+  }
+  
+  DiceLineReader reader(file, limit);
+  int len;
+  while ((len = reader.readLine(line, sizeof(line))) >= 0) {
+    lineNum++;
+    hash = hashBytes(hash, line, len);
+    hash = hashBytes(hash, "\n", 1);
+    
+    // Every line except the signature itself is covered by the MAC
+    if (signedMode && strncmp(line, "signature=", 10) != 0) {
+      unsigned long t = micros();
+      hmac.update(line, len);
+      hmac.update("\n", 1);
+      authMicros += micros() - t;
     }
-    else if (strcmp(key, "checksum") == 0) {
-      _config.checksum = (uint8_t)atoi(value);
+    
+    char* key;
+    char* value;
+    switch (DiceConfigParser::parseLine(line, parsed, &key, &value)) {
+      case DICE_PARSE_NO_SEPARATOR:
+        logEvent(DICE_LOG_LINE_NO_SEPARATOR, lineNum);
+        break;
+      case DICE_PARSE_BAD_MAC:
+        logEvent(DICE_LOG_LINE_BAD_MAC, lineNum);
+        break;
+      case DICE_PARSE_UNKNOWN_KEY:
+        logEvent(DICE_LOG_LINE_UNKNOWN_KEY, lineNum, 0, key);
+        break;
+      case DICE_PARSE_SIGNATURE:
+        haveSignature = parseHex(value, signature, sizeof(signature));
+        break;
+      default:
+        break;
     }
-    else {
-      if (_verbose) {
-        Serial.printf("Line %d: Unknown key '%s'\n", lineNum, key);
+  }
+  
+  if (contentHash) {
+    *contentHash = hash;
+  }
+  
+  // Reject unsigned or tampered files before anything is applied
+  if (signedMode) {
+    unsigned long t = micros();
+    uint8_t expected[DICE_HMAC_SIZE];
+    hmac.finish(expected);
+    authMicros += micros() - t;
+    
+    if (!haveSignature) {
+      setError("Config signature missing");
+      success = false;
+    } else {
+      uint8_t diff = 0;
+      for (size_t i = 0; i < sizeof(expected); i++) {
+        diff |= expected[i] ^ signature[i];
+      }
+      if (diff != 0) {
+        setError("Config signature mismatch");
+        success = false;
       }
     }
   }
   
-  file.close();
-  
   // Validate checksum if not 0
-  if (_config.checksum != 0) {
-    if (!validateChecksum(_config)) {
+  if (success && parsed.checksum != 0) {
+    if (!validateChecksum(parsed)) {
       setError("Checksum validation failed");
-      if (_verbose) {
-        Serial.println("Warning: Checksum validation failed!");
-      }
+      logEvent(DICE_LOG_CHECKSUM_FAILED);
       success = false;
     }
   }
   
-  if (_verbose && success) {
-    Serial.println("Config loaded successfully");
+  if (success) {
+    _config = parsed;
+    publish();
+  }
+  
+  _lastLoadMicros = micros() - startMicros;
+  _lastAuthMicros = authMicros;
+  
+  if (success) {
+    logEvent(DICE_LOG_LOADED, _lastLoadMicros, _lastAuthMicros);
   }
   
   return success;
 }
 
-// Save configuration to file
+// Save configuration to file (or the partition, see enablePartition())
 bool DiceConfigManager::save() {
+  if (_partitionEnabled) {
+    WriteGuard guard(*this);
+    calculateChecksum(_config);
+    publish();
+    return storeToPartition();
+  }
   return save(_configPath);
 }
 
 bool DiceConfigManager::save(const char* filename) {
+  WriteGuard guard(*this);
+  
   // Calculate checksum before saving
   calculateChecksum(_config);
+  publish();
   
-  File file = LittleFS.open(filename, "w");
-  if (!file) {
-    setError("Failed to open config file for writing");
+  return writeConfigFile(filename);
+}
+
+// Write _config as text; checksum and publishing are up to the caller
+bool DiceConfigManager::writeConfigFile(const char* filename) {
+  char macA[18], macB1[18], macB2[18];
+  formatMac(_config.deviceA_mac, macA);
+  formatMac(_config.deviceB1_mac, macB1);
+  formatMac(_config.deviceB2_mac, macB2);
+  
+  // Render the whole file first so storage sees a single write
+  char text[768];
+  int len = snprintf(text, sizeof(text),
+    "# Dice Configuration File\n"
+    "# Auto-generated - Edit with care\n"
+    "\n"
+    "# Device Identification\n"
+    "diceId=%s\n"
+    "\n"
+    "# Device MAC Addresses (format: AA:BB:CC:DD:EE:FF)\n"
+    "deviceA_mac=%s\n"
+    "deviceB1_mac=%s\n"
+    "deviceB2_mac=%s\n"
+    "\n"
+    "# Display Colors (16-bit RGB565 format)\n"
+    "x_background=%u\n"
+    "y_background=%u\n"
+    "z_background=%u\n"
+    "entang_ab1_color=%u\n"
+    "entang_ab2_color=%u\n"
+    "\n"
+    "# RSSI Settings\n"
+    "rssiLimit=%d\n"
+    "\n"
+    "# Hardware Configuration\n"
+    "isSMD=%s\n"
+    "isNano=%s\n"
+    "alwaysSeven=%s\n"
+    "\n"
+    "# Operational Parameters\n"
+    "randomSwitchPoint=%u\n"
+    "tumbleConstant=%.2f\n"
+    "deepSleepTimeout=%u\n"
+    "\n"
+    "# Checksum (auto-calculated)\n"
+    "checksum=%u\n",
+    _config.diceId,
+    macA, macB1, macB2,
+    _config.x_background, _config.y_background, _config.z_background,
+    _config.entang_ab1_color, _config.entang_ab2_color,
+    _config.rssiLimit,
+    _config.isSMD ? "true" : "false",
+    _config.isNano ? "true" : "false",
+    _config.alwaysSeven ? "true" : "false",
+    _config.randomSwitchPoint, _config.tumbleConstant, _config.deepSleepTimeout,
+    _config.checksum);
+  if (len < 0 || (size_t)len >= sizeof(text)) {
+    setError("Config text too long");
+    return false;
+  }
+  
+  if (!ensureMounted()) {
     return false;
   }
   
-  // Write header
-  file.println("# Dice Configuration File");
-  file.println("# Auto-generated - Edit with care");
-  file.println();
-  
-  // Device Identification
-  file.println("# Device Identification");
-  file.printf("diceId=%s\n", _config.diceId);
-  file.println();
-  
-  // MAC Addresses
-  file.println("# Device MAC Addresses (format: AA:BB:CC:DD:EE:FF)");
-  file.printf("deviceA_mac=%s\n", macToString(_config.deviceA_mac).c_str());
-  file.printf("deviceB1_mac=%s\n", macToString(_config.deviceB1_mac).c_str());
-  file.printf("deviceB2_mac=%s\n", macToString(_config.deviceB2_mac).c_str());
-  file.println();
-  
-  // Display Colors
-  file.println("# Display Colors (16-bit RGB565 format)");
-  file.printf("x_background=%u\n", _config.x_background);
-  file.printf("y_background=%u\n", _config.y_background);
-  file.printf("z_background=%u\n", _config.z_background);
-  file.printf("entang_ab1_color=%u\n", _config.entang_ab1_color);
-  file.printf("entang_ab2_color=%u\n", _config.entang_ab2_color);
-  file.println();
-  
-  // RSSI Settings
-  file.println("# RSSI Settings");
-  file.printf("rssiLimit=%d\n", _config.rssiLimit);
-  file.println();
-  
-  // Hardware Configuration
-  file.println("# Hardware Configuration");
-  file.printf("isSMD=%s\n", _config.isSMD ? "true" : "false");
-  file.printf("isNano=%s\n", _config.isNano ? "true" : "false");
-  file.printf("alwaysSeven=%s\n", _config.alwaysSeven ? "true" : "false");
-  file.println();
-  
-  // Operational Parameters
-  file.println("# Operational Parameters");
-  file.printf("randomSwitchPoint=%u\n", _config.randomSwitchPoint);
-  file.printf("tumbleConstant=%.2f\n", _config.tumbleConstant);
-  file.printf("deepSleepTimeout=%u\n", _config.deepSleepTimeout);
-  file.println();
-  
-  // Checksum
-  file.println("# Checksum (auto-calculated)");
-  file.printf("checksum=%u\n", _config.checksum);
+  // A new file may be a second match that a stampless index can't see
+  bool created = !_storage.exists(filename);
   
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, filename, "w")) {
+    setError("Failed to open config file for writing");
+    return false;
+  }
+  
+  size_t written = file.write(text, len);
   file.close();
   
-  if (_verbose) {
-    Serial.println("Config saved successfully");
+  if (written != (size_t)len) {
+    setError("Failed to write config file");
+    _loadedValid = false;
+    return false;
+  }
+  
+  // The file on disk changed underneath the last load fingerprint
+  _loadedValid = false;
+  if (created && _patterns.match(filename[0] == '/' ? filename + 1 : filename) >= 0) {
+    invalidateConfigIndex();
   }
   
+  if (_signingKeyLen > 0 && !signFile(filename)) {
+    return false;
+  }
+  
+  DiceConfigRtc::invalidate();
+  logEvent(DICE_LOG_SAVED);
+  
   return true;
 }
 
-// Reset to default values
-void DiceConfigManager::setDefaults() {
-  initDefaultConfig();
-  if (_verbose) {
-    Serial.println("Configuration reset to defaults");
-  }
+// Enable A/B slot persistence (call before begin())
+void DiceConfigManager::enableSlots(uint8_t maxBootAttempts) {
+  _slotsEnabled = true;
+  _maxBootAttempts = maxBootAttempts > 0 ? maxBootAttempts : 1;
 }
 
-// Validate current configuration
-bool DiceConfigManager::validate() {
-  bool valid = true;
+// Confirm the active slot once the application is known to run with it
+void DiceConfigManager::markBootSuccessful() {
+  WriteGuard guard(*this);
   
-  // Check dice ID is not empty
-  if (strlen(_config.diceId) == 0) {
-    if (_verbose) Serial.println("Validation error: diceId is empty");
-    valid = false;
+  if (!_slotsEnabled || _slotState.confirmed) {
+    return;
   }
   
-  // Check randomSwitchPoint is in range
-  if (_config.randomSwitchPoint > 100) {
-    if (_verbose) Serial.println("Validation error: randomSwitchPoint > 100");
-    valid = false;
+  _slotState.confirmed = 1;
+  _slotState.bootCount = 0;
+  writeSlotState();
+  
+  logEvent(DICE_LOG_SLOT_CONFIRMED, _slotState.active);
+}
+
+// Switch to the other slot without parsing anything
+bool DiceConfigManager::rollback() {
+  WriteGuard guard(*this);
+  
+  uint8_t previous = _slotState.active ^ 1;
+  ConfigSlot slot;
+  if (!readSlot(previous, slot)) {
+    setError("No last-known-good slot to roll back to");
+    return false;
   }
   
-  // Check tumbleConstant is positive
-  if (_config.tumbleConstant <= 0) {
-    if (_verbose) Serial.println("Validation error: tumbleConstant <= 0");
-    valid = false;
+  // Remember the rejected source so it is not promoted again on next boot
+  ConfigSlot rejected;
+  if (readSlot(_slotState.active, rejected)) {
+    _slotState.rejectedContentHash = rejected.sourceContentHash;
+    _slotState.rejectedSize = rejected.sourceSize;
+    _slotState.rejectedWriteTime = rejected.sourceWriteTime;
   }
   
-  // Validate checksum
-  if (_config.checksum != 0 && !validateChecksum(_config)) {
-    if (_verbose) Serial.println("Validation error: checksum mismatch");
-    valid = false;
+  _slotState.active = previous;
+  _slotState.confirmed = 1;
+  _slotState.bootCount = 0;
+  writeSlotState();
+  
+  _config = slot.config;
+  publish();
+  
+  logEvent(DICE_LOG_SLOT_ROLLED_BACK, previous);
+  return true;
+}
+
+// Require (and produce) HMAC-SHA256 signed config files
+bool DiceConfigManager::setSigningKey(const uint8_t* key, size_t len) {
+  if (key == nullptr || len == 0) {
+    _signingKeyLen = 0;
+    return true;
+  }
+  if (len > sizeof(_signingKey)) {
+    setError("Signing key too long");
+    return false;
   }
   
-  return valid;
+  memcpy(_signingKey, key, len);
+  _signingKeyLen = len;
+  return true;
 }
 
-// Get configuration
-DiceConfig& DiceConfigManager::getConfig() {
-  return _config;
+unsigned long DiceConfigManager::getLastLoadMicros() {
+  return _lastLoadMicros;
 }
 
-// Set configuration
-void DiceConfigManager::setConfig(const DiceConfig& newConfig) {
-  _config = newConfig;
+unsigned long DiceConfigManager::getLastAuthMicros() {
+  return _lastAuthMicros;
 }
 
-// Individual setters
-void DiceConfigManager::setDiceId(const char* id) {
-  strncpy(_config.diceId, id, sizeof(_config.diceId) - 1);
-  _config.diceId[sizeof(_config.diceId) - 1] = '\0';
+uint8_t DiceConfigManager::getActiveSlot() {
+  return _slotState.active;
 }
 
-void DiceConfigManager::setDeviceAMac(const uint8_t* mac) {
-  memcpy(_config.deviceA_mac, mac, 6);
+uint8_t DiceConfigManager::getBootCount() {
+  return _slotState.bootCount;
 }
 
-void DiceConfigManager::setDeviceB1Mac(const uint8_t* mac) {
-  memcpy(_config.deviceB1_mac, mac, 6);
+// Restore from RTC memory in begin() (call before begin())
+void DiceConfigManager::enableRtcCache(uint32_t generation) {
+  _rtcEnabled = true;
+  _rtcGeneration = generation;
 }
 
-void DiceConfigManager::setDeviceB2Mac(const uint8_t* mac) {
-  memcpy(_config.deviceB2_mac, mac, 6);
+// Keep the current config in RTC memory; call right before deep sleep
+bool DiceConfigManager::storeToRtc() {
+  WriteGuard guard(*this);
+  
+  if (!validate()) {
+    return false;
+  }
+  
+  // A trial slot must go through boot counting again on wake
+  if (_slotsEnabled && !_slotState.confirmed) {
+    setError("Trial config not stored in RTC memory");
+    return false;
+  }
+  
+  DiceConfigRtc::store(_config, _configPath, _rtcGeneration);
+  logEvent(DICE_LOG_RTC_STORED, _rtcGeneration);
+  return true;
 }
 
-void DiceConfigManager::setRssiLimit(int8_t limit) {
-  _config.rssiLimit = limit;
+void DiceConfigManager::invalidateRtc() {
+  DiceConfigRtc::invalidate();
 }
 
-void DiceConfigManager::setIsSMD(bool value) {
-  _config.isSMD = value;
+bool DiceConfigManager::wasRestoredFromRtc() {
+  return _rtcRestored;
 }
 
-void DiceConfigManager::setIsNano(bool value) {
-  _config.isNano = value;
+bool DiceConfigManager::restoreFromRtc(const char* configPath) {
+  WriteGuard guard(*this);
+  
+  DiceConfig restored;
+  char path[sizeof(_configPath)];
+  if (!DiceConfigRtc::restore(restored, path, sizeof(path), _rtcGeneration)) {
+    logEvent(DICE_LOG_RTC_MISMATCH);
+    return false;
+  }
+  
+  // Image belongs to a different file than the one asked for
+  if (configPath != nullptr && strcmp(configPath, path) != 0) {
+    logEvent(DICE_LOG_RTC_MISMATCH);
+    return false;
+  }
+  
+  // Used once: storeToRtc() before the next sleep writes a fresh image
+  DiceConfigRtc::invalidate();
+  _config = restored;
+  strcpy(_configPath, path);
+  _rtcRestored = true;
+  publish();
+  logEvent(DICE_LOG_RTC_RESTORED, _rtcGeneration);
+  return true;
 }
 
-void DiceConfigManager::setAlwaysSeven(bool value) {
-  _config.alwaysSeven = value;
+// Open the raw partition (call before begin())
+bool DiceConfigManager::enablePartition(const char* label) {
+  WriteGuard guard(*this);
+  
+  if (!_partition.begin(label)) {
+    setError(_partition.getLastError(), false);
+    return false;
+  }
+  _partitionEnabled = true;
+  return true;
 }
 
-// Print configuration
-void DiceConfigManager::printConfig() {
-  Serial.println("=== Dice Configuration ===");
-  Serial.printf("Dice ID: %s\n", _config.diceId);
-  Serial.print("Device A MAC: "); printMacAddress(_config.deviceA_mac);
-  Serial.print("Device B1 MAC: "); printMacAddress(_config.deviceB1_mac);
-  Serial.print("Device B2 MAC: "); printMacAddress(_config.deviceB2_mac);
-  Serial.printf("X Background: 0x%04X (%u)\n", _config.x_background, _config.x_background);
-  Serial.printf("Y Background: 0x%04X (%u)\n", _config.y_background, _config.y_background);
-  Serial.printf("Z Background: 0x%04X (%u)\n", _config.z_background, _config.z_background);
-  Serial.printf("Entangle AB1 Color: 0x%04X (%u)\n", _config.entang_ab1_color, _config.entang_ab1_color);
-  Serial.printf("Entangle AB2 Color: 0x%04X (%u)\n", _config.entang_ab2_color, _config.entang_ab2_color);
-  Serial.printf("RSSI Limit: %d dBm\n", _config.rssiLimit);
-  Serial.printf("Is SMD: %s\n", _config.isSMD ? "true" : "false");
-  Serial.printf("Is Nano: %s\n", _config.isNano ? "true" : "false");
-  Serial.printf("Always Seven: %s\n", _config.alwaysSeven ? "true" : "false");
-  Serial.printf("Random Switch Point: %u%%\n", _config.randomSwitchPoint);
-  Serial.printf("Tumble Constant: %.2f\n", _config.tumbleConstant);
-  Serial.printf("Deep Sleep Timeout: %u ms\n", _config.deepSleepTimeout);
-  Serial.printf("Checksum: 0x%02X\n", _config.checksum);
-  Serial.println("==========================");
+DiceConfigPartition& DiceConfigManager::getPartition() {
+  return _partition;
 }
 
-void DiceConfigManager::printMacAddress(const uint8_t* mac) {
-  Serial.printf("%02X:%02X:%02X:%02X:%02X:%02X\n",
-                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+bool DiceConfigManager::restoreFromPartition() {
+  WriteGuard guard(*this);
+  
+  // The record is read in place; the one copy is into the editable config
+  const DiceConfig* stored = _partition.config();
+  if (stored == nullptr || DiceConfigParser::validate(*stored) != 0) {
+    logEvent(DICE_LOG_PARTITION_EMPTY);
+    return false;
+  }
+  
+  _config = *stored;
+  publish();
+  logEvent(DICE_LOG_PARTITION_RESTORED, _partition.getSequence());
+  return true;
 }
 
-String DiceConfigManager::macToString(const uint8_t* mac) {
-  char buffer[18];
-  snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X",
-           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  return String(buffer);
+bool DiceConfigManager::storeToPartition() {
+  if (!validate()) {
+    return false;
+  }
+  
+  if (!_partition.write(_config)) {
+    setError(_partition.getLastError(), false);
+    return false;
+  }
+  DiceConfigRtc::invalidate();
+  logEvent(DICE_LOG_PARTITION_STORED, _partition.getSequence());
+  return true;
 }
 
-const char* DiceConfigManager::getLastError() {
+// Mount on first file access. A filesystem that the application or
+// another library already mounted is reused as is.
+bool DiceConfigManager::ensureMounted() {
+  if (_storage.isMounted()) {
+    if (!_mountLogged) {
+      _mountLogged = true;
+      logEvent(_storage.isShared() ? DICE_LOG_MOUNT_SHARED : DICE_LOG_MOUNTED);
+    }
+    return true;
+  }
+  if (!_storage.mount(_formatOnFail)) {
+    setError("Storage mount failed");
+    return false;
+  }
+  _mountLogged = true;
+  logEvent(DICE_LOG_MOUNTED);
+  return true;
+}
+
+// Start a batch of setter calls; nothing is published until commit()
+void DiceConfigManager::beginUpdate() {
+  lockWriter();
+  
+  if (_updateDepth++ == 0) {
+    _updateBase = _config;
+#if !defined(ESP_PLATFORM)
+    _updateOwner = std::this_thread::get_id();
+#endif
+  }
+}
+
+// Validate, checksum, publish and persist the batch as one change set
+bool DiceConfigManager::commit(bool persist) {
+  if (_updateDepth == 0) {
+    setError("commit() without beginUpdate()");
+    return false;
+  }
+  
+  // Only the thread holding the writer lock may release it
+  if (!ownsUpdate()) {
+    setError("commit() from another thread");
+    return false;
+  }
+  
+  // Nested updates fold into the outermost one
+  if (_updateDepth > 1) {
+    _updateDepth--;
+    unlockWriter();
+    return true;
+  }
+  
+  // The checksum is recomputed below; the one from before the edits
+  // would always fail validation
+  _config.checksum = 0;
+  bool success = validate();
+  if (!success) {
+    setError("Update rejected by validation");
+    _config = _updateBase;
+  } else {
+    calculateChecksum(_config);
+  }
+  
+  _updateDepth = 0;
+  publish();
+  
+  if (success && persist) {
+#if defined(ESP_PLATFORM)
+    bool workerRunning = _asyncTask != nullptr;
+#else
+    bool workerRunning = _asyncStarted;
+#endif
+    if (workerRunning) {
+      success = saveAsync();
+    } else if (_partitionEnabled) {
+      success = storeToPartition();
+    } else {
+      success = writeConfigFile(_configPath);
+    }
+  }
+  
+  unlockWriter();
+  return success;
+}
+
+// Drop all changes made since beginUpdate()
+void DiceConfigManager::abort() {
+  if (_updateDepth == 0) {
+    return;
+  }
+  
+  if (!ownsUpdate()) {
+    return;
+  }
+  
+  // Every beginUpdate() level holds the lock once
+  _config = _updateBase;
+  while (_updateDepth > 0) {
+    _updateDepth--;
+    unlockWriter();
+  }
+}
+
+// Reset to default values
+void DiceConfigManager::setDefaults() {
+  WriteGuard guard(*this);
+  
+  initDefaultConfig();
+  publish();
+  logEvent(DICE_LOG_DEFAULTS);
+}
+
+// Use a compiled-in config as the defaults and the starting point
+void DiceConfigManager::setBaseConfig(const DiceConfig& base) {
+  WriteGuard guard(*this);
+  
+  _baseConfig = base;
+  initDefaultConfig();
+  publish();
+}
+
+const DiceConfig& DiceConfigManager::getBaseConfig() {
+  return _baseConfig;
+}
+
+// Validate current configuration
+bool DiceConfigManager::validate() {
+  uint32_t errors = DiceConfigParser::validate(_config);
+  
+  if (errors & DICE_INVALID_ID) {
+    logEvent(DICE_LOG_INVALID_ID);
+  }
+  if (errors & DICE_INVALID_SWITCH_POINT) {
+    logEvent(DICE_LOG_INVALID_SWITCH_POINT);
+  }
+  if (errors & DICE_INVALID_TUMBLE) {
+    logEvent(DICE_LOG_INVALID_TUMBLE);
+  }
+  if (errors & DICE_INVALID_CHECKSUM) {
+    logEvent(DICE_LOG_INVALID_CHECKSUM);
+  }
+  
+  return errors == 0;
+}
+
+// Get configuration
+DiceConfig& DiceConfigManager::getConfig() {
+  return _config;
+}
+
+// Set configuration
+void DiceConfigManager::setConfig(const DiceConfig& newConfig) {
+  WriteGuard guard(*this);
+  
+  _config = newConfig;
+  publish();
+}
+
+// Publish the working config to snapshot() readers.
+// Writes go to the buffer readers are not using, then the index flips;
+// each buffer carries a sequence number so a reader overlapping two
+// publishes notices and retries.
+void DiceConfigManager::publish() {
+  WriteGuard guard(*this);
+  
+  // Inside beginUpdate()/commit() readers keep the pre-update config
+  if (_updateDepth > 0) {
+    return;
+  }
+  
+  uint32_t words[SNAPSHOT_WORDS];
+  memset(words, 0, sizeof(words));
+  memcpy(words, &_config, sizeof(_config));
+  
+  uint8_t target = _publishIndex.load(std::memory_order_relaxed) ^ 1;
+  SnapshotBuffer& buffer = _snapshots[target];
+  uint32_t seq = buffer.seq.load(std::memory_order_relaxed);
+  
+  buffer.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < SNAPSHOT_WORDS; i++) {
+    buffer.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  buffer.seq.store(seq + 2, std::memory_order_release);
+  
+  _publishIndex.store(target, std::memory_order_release);
+  _generation.fetch_add(1, std::memory_order_release);
+  
+  // Observers hear about it once the writer lock is released
+  uint32_t changed = diffConfig(_lastPublished, _config);
+  _lastPublished = _config;
+  _changedFields = changed;
+  _unnotifiedFields |= changed;
+}
+
+// Lock-free read of the last published config (safe from any task or core)
+DiceConfig DiceConfigManager::snapshot() const {
+  uint32_t words[SNAPSHOT_WORDS];
+  
+  for (;;) {
+    const SnapshotBuffer& buffer = _snapshots[_publishIndex.load(std::memory_order_acquire)];
+    uint32_t before = buffer.seq.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;  // Writer lapped us and is filling this buffer
+    }
+    for (size_t i = 0; i < SNAPSHOT_WORDS; i++) {
+      words[i] = buffer.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (buffer.seq.load(std::memory_order_relaxed) == before) {
+      break;
+    }
+  }
+  
+  DiceConfig config;
+  memcpy(&config, words, sizeof(config));
+  return config;
+}
+
+uint32_t DiceConfigManager::getGeneration() const {
+  return _generation.load(std::memory_order_acquire);
+}
+
+int DiceConfigManager::addObserver(uint32_t fields, DiceConfigObserver observer, void* context) {
+  WriteGuard guard(*this);
+  
+  for (int i = 0; i < DICE_CONFIG_MAX_OBSERVERS; i++) {
+    if (_observers[i].fn == nullptr) {
+      _observers[i].fn = observer;
+      _observers[i].context = context;
+      _observers[i].fields = fields & DICE_GROUP_ALL;
+      rebuildSubscribers();
+      return i;
+    }
+  }
+  
+  setError("Too many config observers");
+  return -1;
+}
+
+void DiceConfigManager::removeObserver(int id) {
+  WriteGuard guard(*this);
+  
+  if (id < 0 || id >= DICE_CONFIG_MAX_OBSERVERS) {
+    return;
+  }
+  memset(&_observers[id], 0, sizeof(_observers[id]));
+  rebuildSubscribers();
+}
+
+uint32_t DiceConfigManager::getChangedFields() {
+  return _changedFields;
+}
+
+// Individual setters
+void DiceConfigManager::setDiceId(const char* id) {
+  WriteGuard guard(*this);
+  
+  strncpy(_config.diceId, id, sizeof(_config.diceId) - 1);
+  _config.diceId[sizeof(_config.diceId) - 1] = '\0';
+  publish();
+}
+
+void DiceConfigManager::setDeviceAMac(const uint8_t* mac) {
+  WriteGuard guard(*this);
+  
+  memcpy(_config.deviceA_mac, mac, 6);
+  publish();
+}
+
+void DiceConfigManager::setDeviceB1Mac(const uint8_t* mac) {
+  WriteGuard guard(*this);
+  
+  memcpy(_config.deviceB1_mac, mac, 6);
+  publish();
+}
+
+void DiceConfigManager::setDeviceB2Mac(const uint8_t* mac) {
+  WriteGuard guard(*this);
+  
+  memcpy(_config.deviceB2_mac, mac, 6);
+  publish();
+}
+
+void DiceConfigManager::setRssiLimit(int8_t limit) {
+  WriteGuard guard(*this);
+  
+  _config.rssiLimit = limit;
+  publish();
+}
+
+void DiceConfigManager::setIsSMD(bool value) {
+  WriteGuard guard(*this);
+  
+  _config.isSMD = value;
+  publish();
+}
+
+void DiceConfigManager::setIsNano(bool value) {
+  WriteGuard guard(*this);
+  
+  _config.isNano = value;
+  publish();
+}
+
+void DiceConfigManager::setAlwaysSeven(bool value) {
+  WriteGuard guard(*this);
+  
+  _config.alwaysSeven = value;
+  publish();
+}
+
+// Print configuration: rendered into one buffer, then written in one call
+void DiceConfigManager::printConfig(Print& out) {
+  char buffer[DICE_CONFIG_REPORT_SIZE];
+  size_t len = formatConfig(buffer, sizeof(buffer));
+  out.write((const uint8_t*)buffer, len);
+}
+
+void DiceConfigManager::printConfig(DiceConfigWriter writer, void* context) {
+  char buffer[DICE_CONFIG_REPORT_SIZE];
+  size_t len = formatConfig(buffer, sizeof(buffer));
+  writer(buffer, len, context);
+}
+
+size_t DiceConfigManager::formatConfig(char* buffer, size_t size) {
+  size_t len = DiceConfigReport::format(_config, buffer, size);
+  return len < size ? len : (size > 0 ? size - 1 : 0);
+}
+
+void DiceConfigManager::printMacAddress(const uint8_t* mac) {
+  Serial.printf("%02X:%02X:%02X:%02X:%02X:%02X\n",
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+String DiceConfigManager::macToString(const uint8_t* mac) {
+  char buffer[18];
+  formatMac(mac, buffer);
+  return String(buffer);
+}
+
+void DiceConfigManager::formatMac(const uint8_t* mac, char* buffer) {
+  snprintf(buffer, 18, "%02X:%02X:%02X:%02X:%02X:%02X",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+const char* DiceConfigManager::getLastError() {
   return _lastError;
 }
 
@@ -393,170 +1187,996 @@ void DiceConfigManager::setVerbose(bool enabled) {
   _verbose = enabled;
 }
 
+size_t DiceConfigManager::drainLog(Print& out, size_t maxRecords) {
+  return _log.drain(out, maxRecords);
+}
+
 const char* DiceConfigManager::getConfigPath() {
   return _configPath;
 }
 
+DiceConfigStorage& DiceConfigManager::getStorage() {
+  return _storage;
+}
+
 // Private methods
-bool DiceConfigManager::findConfigFile(char* foundPath, size_t maxLen) {
-  File root = LittleFS.open("/");
-  if (!root) {
-    if (_verbose) {
-      Serial.println("Failed to open root directory");
+void DiceConfigManager::rebuildSubscribers() {
+  memset(_fieldSubscribers, 0, sizeof(_fieldSubscribers));
+  for (int i = 0; i < DICE_CONFIG_MAX_OBSERVERS; i++) {
+    if (_observers[i].fn == nullptr) {
+      continue;
+    }
+    for (int bit = 0; bit < DICE_FIELD_COUNT; bit++) {
+      if (_observers[i].fields & (1UL << bit)) {
+        _fieldSubscribers[bit] |= 1UL << i;
+      }
     }
+  }
+}
+
+uint32_t DiceConfigManager::diffConfig(const DiceConfig& a, const DiceConfig& b) {
+  uint32_t changed = 0;
+  
+  if (strncmp(a.diceId, b.diceId, sizeof(a.diceId)) != 0) changed |= DICE_FIELD_DICE_ID;
+  if (memcmp(a.deviceA_mac, b.deviceA_mac, 6) != 0) changed |= DICE_FIELD_DEVICE_A_MAC;
+  if (memcmp(a.deviceB1_mac, b.deviceB1_mac, 6) != 0) changed |= DICE_FIELD_DEVICE_B1_MAC;
+  if (memcmp(a.deviceB2_mac, b.deviceB2_mac, 6) != 0) changed |= DICE_FIELD_DEVICE_B2_MAC;
+  if (a.x_background != b.x_background) changed |= DICE_FIELD_X_BACKGROUND;
+  if (a.y_background != b.y_background) changed |= DICE_FIELD_Y_BACKGROUND;
+  if (a.z_background != b.z_background) changed |= DICE_FIELD_Z_BACKGROUND;
+  if (a.entang_ab1_color != b.entang_ab1_color) changed |= DICE_FIELD_ENTANG_AB1_COLOR;
+  if (a.entang_ab2_color != b.entang_ab2_color) changed |= DICE_FIELD_ENTANG_AB2_COLOR;
+  if (a.rssiLimit != b.rssiLimit) changed |= DICE_FIELD_RSSI_LIMIT;
+  if (a.isSMD != b.isSMD) changed |= DICE_FIELD_IS_SMD;
+  if (a.isNano != b.isNano) changed |= DICE_FIELD_IS_NANO;
+  if (a.alwaysSeven != b.alwaysSeven) changed |= DICE_FIELD_ALWAYS_SEVEN;
+  if (a.randomSwitchPoint != b.randomSwitchPoint) changed |= DICE_FIELD_RANDOM_SWITCH_POINT;
+  if (a.tumbleConstant != b.tumbleConstant) changed |= DICE_FIELD_TUMBLE_CONSTANT;
+  if (a.deepSleepTimeout != b.deepSleepTimeout) changed |= DICE_FIELD_DEEP_SLEEP_TIMEOUT;
+  
+  return changed;
+}
+
+bool DiceConfigManager::queueAsync(uint8_t op, DiceConfigCallback callback, void* context) {
+  if (!startAsyncWorker()) {
+    setError("Failed to start async worker");
     return false;
   }
   
-  if (!root.isDirectory()) {
-    if (_verbose) {
-      Serial.println("Root is not a directory");
+  lockAsync();
+  
+  // Coalesce with an already pending request of the same kind
+  AsyncQueue& queue = _asyncQueues[asyncQueueIndex(op)];
+  if (callback != nullptr) {
+    bool known = false;
+    for (uint8_t i = 0; i < queue.count; i++) {
+      if (queue.callbacks[i].fn == callback && queue.callbacks[i].context == context) {
+        known = true;
+      }
+    }
+    if (!known) {
+      if (queue.count >= ASYNC_MAX_CALLBACKS) {
+        unlockAsync();
+        setError("Too many pending async callbacks");
+        return false;
+      }
+      queue.callbacks[queue.count].fn = callback;
+      queue.callbacks[queue.count].context = context;
+      queue.count++;
     }
-    return false;
   }
   
-  int matchCount = 0;
-  char firstMatch[64] = {0};
+  if ((_asyncPending & op) == 0) {
+    uint8_t queued = 0;
+    for (uint8_t pending = _asyncPending; pending != 0; pending &= pending - 1) {
+      queued++;
+    }
+    _asyncOrder[queued] = op;
+    _asyncPending |= op;
+  }
+  _asyncState.store(DICE_ASYNC_PENDING, std::memory_order_release);
+  unlockAsync();
+  
+#if defined(ESP_PLATFORM)
+  xTaskNotifyGive(_asyncTask);
+#else
+  _asyncWake.notify_one();
+#endif
+  return true;
+}
+
+bool DiceConfigManager::startAsyncWorker() {
+#if defined(ESP_PLATFORM)
+  if (_asyncTask != nullptr) {
+    return true;
+  }
+  return xTaskCreate(asyncTaskEntry, "DiceConfig", DICE_CONFIG_ASYNC_STACK, this,
+                     DICE_CONFIG_ASYNC_PRIORITY, &_asyncTask) == pdPASS;
+#else
+  if (!_asyncStarted) {
+    _asyncThread = std::thread(&DiceConfigManager::asyncLoop, this);
+    _asyncStarted = true;
+  }
+  return true;
+#endif
+}
+
+void DiceConfigManager::stopAsyncWorker() {
+  lockAsync();
+  _asyncStop = true;
+  unlockAsync();
   
-  File file = root.openNextFile();
-  while (file) {
-    String filename = String(file.name());
+#if defined(ESP_PLATFORM)
+  // The task clears _asyncTask right before it deletes itself
+  while (_asyncTask != nullptr) {
+    xTaskNotifyGive(_asyncTask);
+    vTaskDelay(1);
+  }
+#else
+  _asyncWake.notify_one();
+  if (_asyncStarted) {
+    _asyncThread.join();
+    _asyncStarted = false;
+  }
+#endif
+}
+
+#if defined(ESP_PLATFORM)
+void DiceConfigManager::asyncTaskEntry(void* arg) {
+  DiceConfigManager* manager = (DiceConfigManager*)arg;
+  manager->asyncLoop();
+  manager->_asyncTask = nullptr;
+  vTaskDelete(nullptr);
+}
+#endif
+
+void DiceConfigManager::asyncLoop() {
+  for (;;) {
+    uint8_t ops;
+    uint8_t order[3];
+    AsyncQueue queues[3];
+    
+#if defined(ESP_PLATFORM)
+    lockAsync();
+    while (_asyncPending == 0 && !_asyncStop) {
+      unlockAsync();
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      lockAsync();
+    }
+#else
+    std::unique_lock<std::mutex> lock(_asyncLock);
+    _asyncWake.wait(lock, [this] { return _asyncPending != 0 || _asyncStop; });
+#endif
+    
+    if (_asyncStop) {
+#if defined(ESP_PLATFORM)
+      unlockAsync();
+#endif
+      return;
+    }
+    
+    // Take everything queued so far as one batch
+    ops = _asyncPending;
+    _asyncPending = 0;
+    memcpy(order, _asyncOrder, sizeof(order));
+    memcpy(queues, _asyncQueues, sizeof(queues));
+    memset(_asyncQueues, 0, sizeof(_asyncQueues));
     
-    // Check if filename matches pattern: *_config.txt
-    if (filename.endsWith("_config.txt")) {
-      matchCount++;
-      
-      if (_verbose) {
-        Serial.printf("Found config file: %s\n", filename.c_str());
+#if defined(ESP_PLATFORM)
+    unlockAsync();
+#else
+    lock.unlock();
+#endif
+    
+    // In the order the requests were queued: loadAsync(); saveAsync();
+    // must save what was loaded
+    bool success = true;
+    for (uint8_t pending = ops, i = 0; pending != 0; pending &= pending - 1, i++) {
+      uint8_t op = order[i];
+      bool done;
+      if (op == ASYNC_BEGIN) {
+        done = beginInBackground();
+      } else if (op == ASYNC_SAVE) {
+        done = save();
+      } else {
+        done = load();
       }
-      
-      // Store first match
-      if (matchCount == 1) {
-        strncpy(firstMatch, filename.c_str(), sizeof(firstMatch) - 1);
-        firstMatch[sizeof(firstMatch) - 1] = '\0';
+      const AsyncQueue& queue = queues[asyncQueueIndex(op)];
+      for (uint8_t j = 0; j < queue.count; j++) {
+        queue.callbacks[j].fn(done, queue.callbacks[j].context);
       }
+      success = success && done;
+    }
+    
+    lockAsync();
+    _asyncFailed = _asyncFailed || !success;
+    if (_asyncPending == 0) {
+      _asyncState.store(_asyncFailed ? DICE_ASYNC_FAILED : DICE_ASYNC_SUCCEEDED,
+                        std::memory_order_release);
+      _asyncFailed = false;
+    }
+    unlockAsync();
+  }
+}
+
+// True on the thread that called the open beginUpdate()
+bool DiceConfigManager::ownsUpdate() const {
+#if defined(ESP_PLATFORM)
+  return xSemaphoreGetMutexHolder(_writeLock) == xTaskGetCurrentTaskHandle();
+#else
+  return _updateOwner == std::this_thread::get_id();
+#endif
+}
+
+void DiceConfigManager::lockWriter() {
+#if defined(ESP_PLATFORM)
+  xSemaphoreTakeRecursive(_writeLock, portMAX_DELAY);
+#else
+  _writeLock.lock();
+#endif
+  _writeDepth++;
+}
+
+// The outermost release notifies observers of everything published
+// under the lock, after letting go of it: one call per change set, and
+// observers may block or call back into the manager
+void DiceConfigManager::unlockWriter() {
+  Observer calls[DICE_CONFIG_MAX_OBSERVERS];
+  size_t count = 0;
+  uint32_t changed = 0;
+  DiceConfig config;
+  if (--_writeDepth == 0 && _unnotifiedFields != 0) {
+    changed = _unnotifiedFields;
+    _unnotifiedFields = 0;
+    config = _lastPublished;
+    
+    // Union of subscribers over the changed fields, then only those
+    uint32_t interested = 0;
+    for (uint32_t bits = changed; bits != 0; bits &= bits - 1) {
+      interested |= _fieldSubscribers[__builtin_ctz(bits)];
+    }
+    for (; interested != 0; interested &= interested - 1) {
+      calls[count++] = _observers[__builtin_ctz(interested)];
+    }
+  }
+  
+#if defined(ESP_PLATFORM)
+  xSemaphoreGiveRecursive(_writeLock);
+#else
+  _writeLock.unlock();
+#endif
+  
+  for (size_t i = 0; i < count; i++) {
+    calls[i].fn(changed & calls[i].fields, config, calls[i].context);
+  }
+}
+
+void DiceConfigManager::lockAsync() {
+#if defined(ESP_PLATFORM)
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+#else
+  _asyncLock.lock();
+#endif
+}
+
+void DiceConfigManager::unlockAsync() {
+#if defined(ESP_PLATFORM)
+  xSemaphoreGive(_asyncLock);
+#else
+  _asyncLock.unlock();
+#endif
+}
+
+uint8_t DiceConfigManager::asyncQueueIndex(uint8_t op) {
+  return op == ASYNC_SAVE ? 1 : (op == ASYNC_BEGIN ? 2 : 0);
+}
+
+bool DiceConfigManager::beginFromSlots() {
+  readSlotState();
+  
+  // Trial config crashed too many times: fall back to last-known-good
+  if (!_slotState.confirmed && _slotState.bootCount >= _maxBootAttempts) {
+    logEvent(DICE_LOG_SLOT_BOOT_FAILURES, _slotState.active, _slotState.bootCount);
+    if (rollback()) {
+      return true;
     }
+  }
+  
+  ConfigSlot slot;
+  bool haveActive = readSlot(_slotState.active, slot);
+  
+  size_t fileSize = 0;
+  time_t writeTime = 0;
+  DiceConfigStorage::File file;
+  if (_storage.open(file, _configPath, "r")) {
+    fileSize = file.size();
+    writeTime = file.lastWrite();
+    file.close();
+    
+    uint32_t pathHash = hashBytes(FNV_OFFSET_BASIS, _configPath, strlen(_configPath));
+    
+    // Source file unchanged since it was stored: use the image, no parsing
+    if (haveActive && writeTime != 0 &&
+        slot.sourcePathHash == pathHash &&
+        slot.sourceSize == fileSize &&
+        slot.sourceWriteTime == (uint32_t)writeTime) {
+      _config = slot.config;
+      publish();
+      countBootAttempt();
+      logEvent(DICE_LOG_SLOT_RESTORED, _slotState.active);
+      return true;
+    }
+    
+    // Same file that was already rejected: stay on last-known-good
+    bool knownBad = writeTime != 0 &&
+                    _slotState.rejectedSize == fileSize &&
+                    _slotState.rejectedWriteTime == (uint32_t)writeTime;
     
-    file = root.openNextFile();
+    if (!knownBad && load() && validate()) {
+      if (_loadedContentHash != _slotState.rejectedContentHash) {
+        storeTrialSlot(fileSize, writeTime);
+        return true;
+      }
+    }
+  }
+  
+  // Source missing, invalid or rejected: use the last validated image
+  if (haveActive) {
+    _config = slot.config;
+    publish();
+    setError("Config rejected, using last-known-good slot");
+    return true;
+  }
+  
+  logEvent(DICE_LOG_SLOT_NONE);
+  setDefaults();
+  return true;
+}
+
+bool DiceConfigManager::readSlot(uint8_t index, ConfigSlot& slot) {
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, SLOT_IMAGE_PATHS[index & 1], "r")) {
+    return false;
   }
   
-  root.close();
+  int len = file.read(&slot, sizeof(slot));
+  file.close();
+  
+  return len == (int)sizeof(slot) &&
+         slot.magic == SLOT_IMAGE_MAGIC &&
+         slot.imageHash == hashBytes(FNV_OFFSET_BASIS, &slot.config, sizeof(slot.config));
+}
+
+bool DiceConfigManager::writeSlot(uint8_t index, const ConfigSlot& slot) {
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, SLOT_IMAGE_PATHS[index & 1], "w")) {
+    setError("Failed to write config slot");
+    return false;
+  }
+  
+  size_t len = file.write(&slot, sizeof(slot));
+  file.close();
+  return len == sizeof(slot);
+}
+
+void DiceConfigManager::readSlotState() {
+  DiceConfigStorage::File file;
+  if (ensureMounted() && _storage.open(file, SLOT_STATE_PATH, "r")) {
+    int len = file.read(&_slotState, sizeof(_slotState));
+    file.close();
+    if (len == (int)sizeof(_slotState) && _slotState.magic == SLOT_STATE_MAGIC) {
+      return;
+    }
+  }
+  
+  // First boot with slots: nothing to roll back to yet
+  memset(&_slotState, 0, sizeof(_slotState));
+  _slotState.magic = SLOT_STATE_MAGIC;
+  _slotState.confirmed = 1;
+}
+
+bool DiceConfigManager::writeSlotState() {
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, SLOT_STATE_PATH, "w")) {
+    setError("Failed to write slot state");
+    return false;
+  }
+  
+  size_t len = file.write(&_slotState, sizeof(_slotState));
+  file.close();
+  return len == sizeof(_slotState);
+}
+
+void DiceConfigManager::storeTrialSlot(size_t fileSize, time_t writeTime) {
+  ConfigSlot slot;
+  memset(&slot, 0, sizeof(slot));
+  slot.magic = SLOT_IMAGE_MAGIC;
+  slot.sourcePathHash = hashBytes(FNV_OFFSET_BASIS, _configPath, strlen(_configPath));
+  slot.sourceSize = fileSize;
+  slot.sourceWriteTime = (uint32_t)writeTime;
+  slot.sourceContentHash = _loadedContentHash;
+  slot.config = _config;
+  slot.imageHash = hashBytes(FNV_OFFSET_BASIS, &slot.config, sizeof(slot.config));
+  
+  // Same content with new metadata (e.g. re-upload): refresh, keep boot state
+  ConfigSlot current;
+  if (readSlot(_slotState.active, current) &&
+      current.sourceContentHash == _loadedContentHash) {
+    writeSlot(_slotState.active, slot);
+    countBootAttempt();
+    return;
+  }
+  
+  // Never overwrite a confirmed slot while it is the only good one
+  uint8_t target = _slotState.confirmed ? (_slotState.active ^ 1) : _slotState.active;
+  if (!writeSlot(target, slot)) {
+    return;
+  }
+  
+  _slotState.active = target;
+  _slotState.confirmed = 0;
+  _slotState.bootCount = 1;
+  writeSlotState();
+  
+  logEvent(DICE_LOG_SLOT_STORED, target);
+}
+
+void DiceConfigManager::countBootAttempt() {
+  if (_slotState.confirmed) {
+    return;
+  }
+  
+  _slotState.bootCount++;
+  writeSlotState();
+}
+
+bool DiceConfigManager::findConfigFile(char* foundPath, size_t maxLen) {
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  // Walk the directory only if it changed since the last scan
+  bool stored = readConfigIndex();
+  if (stored && checkConfigIndex()) {
+    logEvent(DICE_LOG_INDEX_HIT, _index.count);
+  } else {
+    ConfigIndex previous;
+    if (stored) {
+      previous = _index;
+    }
+    if (!scanConfigFiles()) {
+      return false;
+    }
+    // Without a directory stamp, a fleet image is rescanned on every
+    // boot; the flash is written only when the result differs
+    if (!stored || !sameConfigIndex(previous)) {
+      writeConfigIndex();
+    }
+  }
+  _indexValid = true;
   
   // Return success only if exactly one match found
-  if (matchCount == 1) {
+  if (_index.count == 1) {
+    const char* match = _index.entries[0].name;
     // Ensure path starts with /
-    if (firstMatch[0] != '/') {
-      snprintf(foundPath, maxLen, "/%s", firstMatch);
+    if (match[0] != '/') {
+      snprintf(foundPath, maxLen, "/%s", match);
     } else {
-      strncpy(foundPath, firstMatch, maxLen - 1);
+      strncpy(foundPath, match, maxLen - 1);
       foundPath[maxLen - 1] = '\0';
     }
     return true;
-  } else if (matchCount == 0) {
-    setError("No *_config.txt file found");
-    if (_verbose) {
-      Serial.println("No files matching *_config.txt pattern found");
-    }
+  } else if (_index.count == 0) {
+    setError("No file matching the config patterns found");
+    logEvent(DICE_LOG_NO_MATCH);
   } else {
-    setError("Multiple *_config.txt files found");
-    if (_verbose) {
-      Serial.printf("Error: Found %d config files. Only one allowed.\n", matchCount);
+    // Fleet image: rebuild the MAC index only if the files changed
+    if (_macSelection) {
+      uint32_t built = 0;
+      bool rebuilt = false;
+      if (!DiceMacIndex::readSourceHash(_storage, DICE_CONFIG_MACIDX_PATH, built) ||
+          built != _index.filesHash) {
+        if (!rebuildMacIndex()) {
+          return false;
+        }
+        rebuilt = true;
+      }
+      if (findConfigByMac(foundPath, maxLen)) {
+        return true;
+      }
+      if (rebuilt) {
+        return false;  // Its error says why the device has no config of its own
+      }
+      // The fingerprint misses edits that keep a file's size, so ask a
+      // fresh index before giving up (a device listed nowhere pays this
+      // rebuild on every boot)
+      logEvent(DICE_LOG_MAC_INDEX_STALE);
+      return rebuildMacIndex() && findConfigByMac(foundPath, maxLen);
     }
+    setError("Multiple files match the config patterns");
+    logEvent(DICE_LOG_MULTIPLE_MATCHES, _index.count);
   }
   
   return false;
 }
 
-bool DiceConfigManager::parseMacAddress(const char* str, uint8_t* mac) {
-  int values[6];
-  if (sscanf(str, "%x:%x:%x:%x:%x:%x",
-             &values[0], &values[1], &values[2],
-             &values[3], &values[4], &values[5]) == 6) {
-    for (int i = 0; i < 6; i++) {
-      mac[i] = (uint8_t)values[i];
-    }
-    return true;
+bool DiceConfigManager::setConfigPatterns(const char* patterns) {
+  WriteGuard guard(*this);
+  
+  // Compile aside so a bad list keeps the current patterns
+  DicePatternSet compiled;
+  if (!compiled.compile(patterns)) {
+    setError("Invalid config file patterns");
+    return false;
   }
-  return false;
+  _patterns = compiled;
+  _indexValid = false;
+  return true;
+}
+
+const DicePatternSet& DiceConfigManager::getConfigPatterns() {
+  return _patterns;
+}
+
+// MAC index records collected by rebuildMacIndex()
+struct MacIndexBuild {
+  DiceConfigStorage* storage;
+  DiceMacIndexRecord* records;
+  size_t count;
+  size_t capacity;
+  uint32_t filesHash;
+  bool overflow;
+  bool pathTooLong;
+};
+
+static void macIndexVisitor(const char* path, int priority, const DiceFileInfo& info,
+                            void* context) {
+  (void)priority;
+  MacIndexBuild& build = *(MacIndexBuild*)context;
+  build.filesHash += DiceMacIndex::fileHash(path, info.size);
+  
+  // A record can't name a longer path
+  char fullPath[sizeof(DiceMacIndexRecord::path) + 1];
+  if (snprintf(fullPath, sizeof(fullPath), "/%s", path) >= (int)sizeof(fullPath)) {
+    build.pathTooLong = true;
+    return;
+  }
+  DiceConfigStorage::File file;
+  if (!build.storage->open(file, fullPath, "r")) {
+    return;
+  }
+  
+  // Only the MACs matter; start from zeroed defaults, not the base config
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+  DiceLineReader reader(file);
+  char line[128];
+  while (reader.readLine(line, sizeof(line)) >= 0) {
+    DiceConfigParser::parseLine(line, config);
+  }
+  file.close();
+  
+  DiceMacIndexRecord records[3];
+  size_t count;
+  if (!DiceMacIndex::recordsFor(path, config, records, count)) {
+    build.pathTooLong = true;
+    return;
+  }
+  if (build.count + count > build.capacity) {
+    build.overflow = true;
+    return;
+  }
+  memcpy(build.records + build.count, records, count * sizeof(records[0]));
+  build.count += count;
+}
+
+void DiceConfigManager::enableMacSelection(bool enabled) {
+  _macSelection = enabled;
 }
 
-bool DiceConfigManager::parseBool(const char* str) {
-  if (strcasecmp(str, "true") == 0 || strcmp(str, "1") == 0) {
+// Parse every matching file for its MACs and write the sorted index
+bool DiceConfigManager::rebuildMacIndex() {
+  WriteGuard guard(*this);
+  
+  if (!ensureMounted()) {
+    return false;
+  }
+  
+  MacIndexBuild build;
+  build.storage = &_storage;
+  build.records = (DiceMacIndexRecord*)malloc(DICE_CONFIG_MACIDX_BUILD_MAX * sizeof(DiceMacIndexRecord));
+  build.count = 0;
+  build.capacity = DICE_CONFIG_MACIDX_BUILD_MAX;
+  build.filesHash = 0;
+  build.overflow = false;
+  build.pathTooLong = false;
+  if (build.records == nullptr) {
+    setError("Not enough memory to build the MAC index");
+    return false;
+  }
+  
+  bool success = _patterns.walk(_storage, macIndexVisitor, &build);
+  if (!success) {
+    logEvent(DICE_LOG_ROOT_OPEN_FAILED);
+  }
+  if (success && build.overflow) {
+    setError("Too many MACs to index on the device, use dice_config_macindex");
+    success = false;
+  }
+  if (success && build.pathTooLong) {
+    setError("A config path is too long for the MAC index");
+    success = false;
+  }
+  if (success && !DiceMacIndex::write(_storage, DICE_CONFIG_MACIDX_PATH,
+                                      build.records, build.count, build.filesHash)) {
+    setError("Failed to write MAC index");
+    success = false;
+  }
+  free(build.records);
+  
+  if (success) {
+    logEvent(DICE_LOG_MAC_INDEX_BUILT, (int32_t)build.count);
+  }
+  return success;
+}
+
+void DiceConfigManager::setDeviceMac(const uint8_t* mac) {
+  memcpy(_deviceMac, mac, sizeof(_deviceMac));
+  _deviceMacSet = true;
+}
+
+bool DiceConfigManager::getDeviceMac(uint8_t* mac) {
+  if (_deviceMacSet) {
+    memcpy(mac, _deviceMac, sizeof(_deviceMac));
     return true;
   }
+#if defined(ESP_PLATFORM)
+  return esp_read_mac(mac, ESP_MAC_WIFI_STA) == ESP_OK;
+#else
   return false;
+#endif
 }
 
-void DiceConfigManager::trim(char* str) {
-  // Trim leading space
-  char* start = str;
-  while (isspace((unsigned char)*start)) start++;
+uint8_t DiceConfigManager::getDeviceRole() {
+  return _deviceRole;
+}
+
+// Binary search of the MAC index; no directory scan, no parsing
+bool DiceConfigManager::findConfigByMac(char* foundPath, size_t maxLen) {
+  uint8_t mac[6];
+  if (!getDeviceMac(mac)) {
+    setError("Device MAC unknown");
+    return false;
+  }
   
-  if (start != str) {
-    memmove(str, start, strlen(start) + 1);
+  DiceMacIndexRecord record;
+  switch (DiceMacIndex::find(_storage, DICE_CONFIG_MACIDX_PATH, mac, record)) {
+    case DiceMacIndex::FOUND:
+      break;
+    case DiceMacIndex::AMBIGUOUS:
+      setError("Device MAC appears in more than one config file");
+      logEvent(DICE_LOG_MAC_AMBIGUOUS);
+      return false;
+    case DiceMacIndex::NOT_FOUND:
+      setError("Device MAC not found in any config file");
+      logEvent(DICE_LOG_MAC_NOT_FOUND);
+      return false;
+    default:
+      return false;
   }
   
-  // Trim trailing space
-  char* end = str + strlen(str) - 1;
-  while (end > str && isspace((unsigned char)*end)) end--;
-  end[1] = '\0';
+  snprintf(foundPath, maxLen, "/%s", record.path);
+  _macSelected = true;
+  _deviceRole = record.role;
+  logEvent(DICE_LOG_MAC_SELECTED, record.role, 0, record.path);
+  return true;
 }
 
-void DiceConfigManager::calculateChecksum(DiceConfig& config) {
-  uint8_t* ptr = (uint8_t*)&config;
-  uint8_t sum = 0;
+// Does the loaded config really list this device?
+bool DiceConfigManager::matchesDeviceMac() {
+  uint8_t mac[6];
+  if (!getDeviceMac(mac)) {
+    return false;
+  }
+  _deviceRole = DiceMacIndex::roleOf(_config, mac);
+  return _deviceRole != DICE_ROLE_NONE;
+}
+
+// Remove the auto-detection index; the next begin() rescans
+void DiceConfigManager::invalidateConfigIndex() {
+  WriteGuard guard(*this);
+  
+  _indexValid = false;
+  if (ensureMounted() && _storage.exists(DICE_CONFIG_INDEX_PATH)) {
+    _storage.remove(DICE_CONFIG_INDEX_PATH);
+  }
+}
+
+bool DiceConfigManager::readConfigIndex() {
+  _indexValid = false;
+  
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, DICE_CONFIG_INDEX_PATH, "r")) {
+    return false;
+  }
+  bool ok = file.size() == sizeof(_index) &&
+            file.read(&_index, sizeof(_index)) == (int)sizeof(_index);
+  file.close();
+  
+  return ok && _index.magic == INDEX_MAGIC &&
+         _index.version == INDEX_VERSION &&
+         _index.patternHash == _patterns.hash();
+}
+
+// Is the index still what a scan would produce?
+bool DiceConfigManager::checkConfigIndex() {
+  uint32_t stamp = 0;
+  bool hasStamp = indexDirStamp(stamp);
+  if (hasStamp != (_index.hasStamp != 0)) {
+    return false;
+  }
+  if (hasStamp) {
+    if (stamp != _index.dirStamp) {
+      return false;
+    }
+  } else if (_index.count != 1) {
+    // Without a directory stamp only a single known file can be trusted
+    return false;
+  }
+  
+  // The indexed files themselves must be unchanged
+  size_t listed = _index.count < DICE_CONFIG_INDEX_ENTRIES ? _index.count : DICE_CONFIG_INDEX_ENTRIES;
+  for (size_t i = 0; i < listed; i++) {
+    const ConfigIndexEntry& entry = _index.entries[i];
+    char path[sizeof(entry.name) + 1];
+    snprintf(path, sizeof(path), "/%s", entry.name);
+    
+    DiceConfigStorage::File file;
+    if (!_storage.open(file, path, "r")) {
+      return false;
+    }
+    bool same = file.size() == entry.size && (uint32_t)file.lastWrite() == entry.lastWrite;
+    file.close();
+    if (!same) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Is the fresh scan in _index what the index file already holds?
+// Carries over the diceIds the file recorded for unchanged entries.
+bool DiceConfigManager::sameConfigIndex(const ConfigIndex& stored) {
+  uint32_t stamp = 0;
+  _index.hasStamp = indexDirStamp(stamp) ? 1 : 0;
+  _index.dirStamp = stamp;
+  
+  for (size_t i = 0; i < DICE_CONFIG_INDEX_ENTRIES; i++) {
+    ConfigIndexEntry& entry = _index.entries[i];
+    const ConfigIndexEntry& old = stored.entries[i];
+    if (strcmp(entry.name, old.name) == 0 && entry.size == old.size &&
+        entry.lastWrite == old.lastWrite) {
+      memcpy(entry.diceId, old.diceId, sizeof(entry.diceId));
+    }
+  }
+  return memcmp(&_index, &stored, sizeof(_index)) == 0;
+}
+
+// Only the root's stamp is tracked; with subdirectory patterns the
+// index is checked like on a backend without stamps
+bool DiceConfigManager::indexDirStamp(uint32_t& stamp) {
+  stamp = 0;
+  return _patterns.maxDepth() == 0 && _storage.dirStamp("/", stamp);
+}
+
+// State of one scanConfigFiles() walk
+struct IndexScan {
+  DiceConfigManager* manager;
+  int bestPriority;
+};
+
+// Index the files that match the best-priority pattern
+bool DiceConfigManager::scanConfigFiles() {
+  memset(&_index, 0, sizeof(_index));
+  _index.magic = INDEX_MAGIC;
+  _index.version = INDEX_VERSION;
+  _index.patternHash = _patterns.hash();
+  
+  IndexScan scan = { this, -1 };
+  if (!_patterns.walk(_storage, indexVisitor, &scan)) {
+    logEvent(DICE_LOG_ROOT_OPEN_FAILED);
+    return false;
+  }
+  return true;
+}
+
+void DiceConfigManager::indexVisitor(const char* path, int priority, const DiceFileInfo& info,
+                                     void* context) {
+  IndexScan& scan = *(IndexScan*)context;
+  DiceConfigManager& manager = *scan.manager;
+  ConfigIndex& index = manager._index;
+  int& bestPriority = scan.bestPriority;
+  
+  index.filesHash += DiceMacIndex::fileHash(path, info.size);
+  if (bestPriority >= 0 && priority > bestPriority) {
+    return;
+  }
+  manager.logEvent(DICE_LOG_FOUND_FILE, 0, 0, path);
   
-  // XOR all bytes except the checksum field itself
-  for (size_t i = 0; i < sizeof(DiceConfig) - 1; i++) {
-    sum ^= ptr[i];
+  // A better pattern matched: drop what the worse one found
+  if (priority < bestPriority || bestPriority < 0) {
+    bestPriority = priority;
+    index.count = 0;
+    memset(index.entries, 0, sizeof(index.entries));
   }
   
-  config.checksum = sum;
+  if (index.count < DICE_CONFIG_INDEX_ENTRIES && strlen(path) < sizeof(index.entries[0].name)) {
+    ConfigIndexEntry& indexed = index.entries[index.count];
+    strcpy(indexed.name, path);
+    indexed.size = info.size;
+    indexed.lastWrite = (uint32_t)info.lastWrite;
+  }
+  if (index.count < 255) {
+    index.count++;
+  }
+}
+
+bool DiceConfigManager::writeConfigIndex() {
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, DICE_CONFIG_INDEX_PATH, "w")) {
+    return false;
+  }
+  
+  // Creating the index file changes the directory, so take the stamp now
+  uint32_t stamp = 0;
+  _index.hasStamp = indexDirStamp(stamp) ? 1 : 0;
+  _index.dirStamp = stamp;
+  
+  bool ok = file.write(&_index, sizeof(_index)) == sizeof(_index);
+  file.close();
+  return ok;
+}
+
+// Remember which dice set the auto-detected file configures
+void DiceConfigManager::updateIndexedDiceId() {
+  if (!_indexValid || _index.count != 1) {
+    return;
+  }
+  
+  ConfigIndexEntry& entry = _index.entries[0];
+  const char* name = _configPath[0] == '/' ? _configPath + 1 : _configPath;
+  if (strcmp(entry.name, name) != 0 ||
+      strncmp(entry.diceId, _config.diceId, sizeof(entry.diceId)) == 0) {
+    return;
+  }
+  
+  memset(entry.diceId, 0, sizeof(entry.diceId));
+  memcpy(entry.diceId, _config.diceId, strnlen(_config.diceId, sizeof(entry.diceId) - 1));
+  writeConfigIndex();
+}
+
+// Append a signature line covering everything written so far
+bool DiceConfigManager::signFile(const char* filename) {
+  DiceConfigStorage::File file;
+  if (!_storage.open(file, filename, "r")) {
+    setError("Failed to reopen config file for signing");
+    return false;
+  }
+  
+  char line[128];
+  DiceConfigHmac hmac;
+  hmac.begin(_signingKey, _signingKeyLen);
+  
+  // Same line framing as parseFile()
+  DiceLineReader reader(file);
+  int len;
+  while ((len = reader.readLine(line, sizeof(line))) >= 0) {
+    if (strncmp(line, "signature=", 10) != 0) {
+      hmac.update(line, len);
+      hmac.update("\n", 1);
+    }
+  }
+  file.close();
+  
+  uint8_t mac[DICE_HMAC_SIZE];
+  hmac.finish(mac);
+  
+  if (!_storage.open(file, filename, "a")) {
+    setError("Failed to append config signature");
+    return false;
+  }
+  
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  char text[10 + 2 * DICE_HMAC_SIZE + 1];
+  memcpy(text, "signature=", 10);
+  for (size_t i = 0; i < sizeof(mac); i++) {
+    text[10 + 2 * i] = HEX_DIGITS[mac[i] >> 4];
+    text[11 + 2 * i] = HEX_DIGITS[mac[i] & 0x0F];
+  }
+  text[sizeof(text) - 1] = '\n';
+  
+  size_t written = file.write(text, sizeof(text));
+  file.close();
+  return written == sizeof(text);
+}
+
+uint32_t DiceConfigManager::hashFile(DiceConfigStorage::File& file) {
+  char line[128];
+  uint32_t hash = FNV_OFFSET_BASIS;
+  
+  // Must read exactly like parseFile() so both produce the same hash
+  DiceLineReader reader(file);
+  int len;
+  while ((len = reader.readLine(line, sizeof(line))) >= 0) {
+    hash = hashBytes(hash, line, len);
+    hash = hashBytes(hash, "\n", 1);
+  }
+  
+  return hash;
+}
+
+uint32_t DiceConfigManager::hashBytes(uint32_t hash, const void* data, size_t len) {
+  const uint8_t* ptr = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= ptr[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+bool DiceConfigManager::parseHex(const char* str, uint8_t* out, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    int hi = hexDigit(str[2 * i]);
+    int lo = hi < 0 ? -1 : hexDigit(str[2 * i + 1]);
+    if (lo < 0) {
+      return false;
+    }
+    out[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return str[2 * len] == '\0';
+}
+
+int DiceConfigManager::hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+void DiceConfigManager::calculateChecksum(DiceConfig& config) {
+  config.checksum = DiceConfigParser::checksum(config);
 }
 
 bool DiceConfigManager::validateChecksum(const DiceConfig& config) {
-  DiceConfig temp = config;
-  uint8_t originalChecksum = temp.checksum;
-  calculateChecksum(temp);
-  return temp.checksum == originalChecksum;
+  return config.checksum == DiceConfigParser::checksum(config);
 }
 
-void DiceConfigManager::setError(const char* error) {
+void DiceConfigManager::setError(const char* error, bool literal) {
   strncpy(_lastError, error, sizeof(_lastError) - 1);
   _lastError[sizeof(_lastError) - 1] = '\0';
   if (_verbose) {
-    Serial.printf("Error: %s\n", error);
+    _log.push(DICE_LOG_ERROR, 0, 0, literal ? nullptr : error, literal ? error : nullptr);
+  }
+}
+
+void DiceConfigManager::logEvent(uint8_t code, int32_t arg0, int32_t arg1, const char* text) {
+  if (_verbose) {
+    _log.push(code, arg0, arg1, text);
   }
 }
 
 void DiceConfigManager::initDefaultConfig() {
-  // Default values
-  strcpy(_config.diceId, "DEFAULT");
-  
-  // Default MAC addresses (all zeros)
-  memset(_config.deviceA_mac, 0, 6);
-  memset(_config.deviceB1_mac, 0, 6);
-  memset(_config.deviceB2_mac, 0, 6);
-  
-  // Default colors (RGB565)
-  _config.x_background = 0xF800;      // Red
-  _config.y_background = 0x07E0;      // Green
-  _config.z_background = 0x001F;      // Blue
-  _config.entang_ab1_color = 0xFFFF;  // White
-  _config.entang_ab2_color = 0x0000;  // Black
-  
-  // Default RSSI
-  _config.rssiLimit = -70;
-  
-  // Default hardware config
-  _config.isSMD = false;
-  _config.isNano = false;
-  _config.alwaysSeven = false;
-  
-  // Default operational parameters
-  _config.randomSwitchPoint = 50;
-  _config.tumbleConstant = 2.5;
-  _config.deepSleepTimeout = 300000;  // 5 minutes
-  
-  // Checksum (will be calculated on save)
-  _config.checksum = 0;
+  _config = _baseConfig;
 }
@@ -1,6 +1,7 @@
 /*
  * DiceConfigManager - Configuration management library for ESP32 Dice
  * Handles loading, saving, and validating configuration from LittleFS
+ * (or another DiceConfigStorage backend selected at build time)
  * 
  * Author: Auto-generated
  * License: MIT
@@ -9,49 +10,202 @@
 #ifndef DICE_CONFIG_MANAGER_H
 #define DICE_CONFIG_MANAGER_H
 
-#include <Arduino.h>
-#include <LittleFS.h>
-
-// Configuration structure
-struct DiceConfig {
-  char diceId[16];              // "TEST1", "BART1", etc.
-  uint8_t deviceA_mac[6];       // MAC address of device A
-  uint8_t deviceB1_mac[6];      // MAC address of device B1
-  uint8_t deviceB2_mac[6];      // MAC address of device B2
-  uint16_t x_background;        // Display background colors
-  uint16_t y_background;
-  uint16_t z_background;
-  uint16_t entang_ab1_color;
-  uint16_t entang_ab2_color;
-  int8_t rssiLimit;             // RSSI limit for entanglement detection
-  bool isSMD;                   // true for SMD, false for HDR
-  bool isNano;                  // true for NANO, false for DEVKIT
-  bool alwaysSeven;             // Force dice to always produce 7
-  uint8_t randomSwitchPoint;    // Threshold for random value (0-100)
-  float tumbleConstant;         // Number of tumbles to detect tumbling
-  uint32_t deepSleepTimeout;    // Deep sleep timeout in milliseconds
-  uint8_t checksum;             // Simple checksum for validation
+#include "DiceConfigPlatform.h"
+#include <atomic>
+#include "DiceConfigStorage.h"
+#include "DiceConfigParser.h"
+#include "DiceConfigHmac.h"
+#include "DiceConfigLog.h"
+#include "DiceConfigReport.h"
+#include "DiceConfigRtc.h"
+#include "DiceConfigPartition.h"
+#include "DiceConfigPattern.h"
+#include "DiceConfigMacIndex.h"
+#include "DiceConfigManifest.h"
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// Worker task settings for loadAsync()/saveAsync() (ESP32)
+#ifndef DICE_CONFIG_ASYNC_STACK
+#define DICE_CONFIG_ASYNC_STACK 6144
+#endif
+#ifndef DICE_CONFIG_ASYNC_PRIORITY
+#define DICE_CONFIG_ASYNC_PRIORITY 1
+#endif
+
+// Auto-detection index: result of the last directory scan
+#ifndef DICE_CONFIG_INDEX_PATH
+#define DICE_CONFIG_INDEX_PATH "/.dcm_index"
+#endif
+#ifndef DICE_CONFIG_INDEX_ENTRIES
+#define DICE_CONFIG_INDEX_ENTRIES 4
+#endif
+
+
+// Field bits used for change notification
+enum DiceConfigField {
+  DICE_FIELD_DICE_ID             = 1UL << 0,
+  DICE_FIELD_DEVICE_A_MAC        = 1UL << 1,
+  DICE_FIELD_DEVICE_B1_MAC       = 1UL << 2,
+  DICE_FIELD_DEVICE_B2_MAC       = 1UL << 3,
+  DICE_FIELD_X_BACKGROUND        = 1UL << 4,
+  DICE_FIELD_Y_BACKGROUND        = 1UL << 5,
+  DICE_FIELD_Z_BACKGROUND        = 1UL << 6,
+  DICE_FIELD_ENTANG_AB1_COLOR    = 1UL << 7,
+  DICE_FIELD_ENTANG_AB2_COLOR    = 1UL << 8,
+  DICE_FIELD_RSSI_LIMIT          = 1UL << 9,
+  DICE_FIELD_IS_SMD              = 1UL << 10,
+  DICE_FIELD_IS_NANO             = 1UL << 11,
+  DICE_FIELD_ALWAYS_SEVEN        = 1UL << 12,
+  DICE_FIELD_RANDOM_SWITCH_POINT = 1UL << 13,
+  DICE_FIELD_TUMBLE_CONSTANT     = 1UL << 14,
+  DICE_FIELD_DEEP_SLEEP_TIMEOUT  = 1UL << 15,
+  DICE_FIELD_CHECKSUM            = 1UL << 16,   // Never reported; follows the fields
+  
+  // Field groups
+  DICE_GROUP_MACS     = DICE_FIELD_DEVICE_A_MAC | DICE_FIELD_DEVICE_B1_MAC | DICE_FIELD_DEVICE_B2_MAC,
+  DICE_GROUP_COLORS   = DICE_FIELD_X_BACKGROUND | DICE_FIELD_Y_BACKGROUND | DICE_FIELD_Z_BACKGROUND |
+                        DICE_FIELD_ENTANG_AB1_COLOR | DICE_FIELD_ENTANG_AB2_COLOR,
+  DICE_GROUP_HARDWARE = DICE_FIELD_IS_SMD | DICE_FIELD_IS_NANO,
+  DICE_GROUP_BEHAVIOR = DICE_FIELD_RSSI_LIMIT | DICE_FIELD_ALWAYS_SEVEN |
+                        DICE_FIELD_RANDOM_SWITCH_POINT | DICE_FIELD_TUMBLE_CONSTANT,
+  DICE_GROUP_POWER    = DICE_FIELD_DEEP_SLEEP_TIMEOUT,
+  DICE_GROUP_ALL      = (1UL << 17) - 1
+};
+
+#define DICE_FIELD_COUNT 17
+
+#ifndef DICE_CONFIG_MAX_OBSERVERS
+#define DICE_CONFIG_MAX_OBSERVERS 8
+#endif
+
+// Each field keeps a 32-bit mask of its subscribers
+static_assert(DICE_CONFIG_MAX_OBSERVERS <= 32, "DICE_CONFIG_MAX_OBSERVERS must be at most 32");
+
+// Change observer: called once per published change set that touches
+// at least one of the fields it registered for
+typedef void (*DiceConfigObserver)(uint32_t changedFields, const DiceConfig& config, void* context);
+
+// Completion callback for loadAsync()/saveAsync(); runs on the worker task
+typedef void (*DiceConfigCallback)(bool success, void* context);
+
+// State of the asynchronous worker, for polling instead of callbacks
+enum DiceAsyncState {
+  DICE_ASYNC_IDLE,
+  DICE_ASYNC_PENDING,
+  DICE_ASYNC_SUCCEEDED,
+  DICE_ASYNC_FAILED
 };
 
 class DiceConfigManager {
 public:
   // Constructor
   DiceConfigManager();
+  ~DiceConfigManager();
   
-  // Initialize LittleFS and load config
+  // Mount storage and load config
   bool begin(const char* configPath = nullptr, bool formatOnFail = true);
   
+  // Boot-budget begin(): returns at once with the RTC snapshot (if
+  // enableRtcCache() found one) or the defaults already published, and
+  // runs mount, discovery and parsing on the background worker. Readers
+  // using snapshot() see a single switch to the loaded config, after
+  // which callback runs on the worker. Don't touch getConfig() until then.
+  // A restored snapshot needs no background work, but callback still
+  // runs on the worker, never inside beginAsync().
+  bool beginAsync(DiceConfigCallback callback = nullptr, void* context = nullptr,
+                  const char* configPath = nullptr, bool formatOnFail = true);
+  
   // Load configuration from file
   bool load();
   bool load(const char* filename);
   
+  // Load one [name] section of a fleet manifest (see DiceConfigManifest.h).
+  // Uses the sidecar index "<manifest>.idx", (re)built when it is missing
+  // or stale. Like load(), keys the section doesn't set keep their values.
+  bool loadFromManifest(const char* manifestPath, const char* name);
+  
+  // Queue load/save on a background worker (FreeRTOS task on ESP32,
+  // std::thread on host). Requests that are still pending are coalesced,
+  // so a burst of saveAsync() calls results in a single write. Pending
+  // requests run in the order they were first queued.
+  bool loadAsync(DiceConfigCallback callback = nullptr, void* context = nullptr);
+  bool saveAsync(DiceConfigCallback callback = nullptr, void* context = nullptr);
+  DiceAsyncState getAsyncState();
+  
+  // Reload only if the config file changed since the last load.
+  // Compares size and last-write time first, then a content hash;
+  // the file is re-parsed only on a real change.
+  bool reloadIfChanged(bool* reloaded = nullptr);
+  
   // Save configuration to file
   bool save();
   bool save(const char* filename);
   
+  // Batched updates: setters between beginUpdate() and commit() are
+  // invisible to snapshot() readers. commit() validates once, computes
+  // the checksum once, publishes once and saves once (queued on the async
+  // worker if it is running). Invalid updates are rolled back.
+  // The writer lock is held until commit() or abort(), so both must be
+  // called on the thread that called beginUpdate(); from another thread
+  // commit() fails and abort() does nothing. A nested commit() folds
+  // into the outer batch; abort() drops the whole batch at any depth.
+  void beginUpdate();
+  bool commit(bool persist = true);
+  void abort();
+  
+  // A/B slot persistence: keep the active and last-known-good configs
+  // as binary images and roll back after maxBootAttempts failed boots
+  void enableSlots(uint8_t maxBootAttempts = 3);
+  void markBootSuccessful();
+  bool rollback();
+  uint8_t getActiveSlot();
+  uint8_t getBootCount();
+  
+  // Deep-sleep fast path: storeToRtc() before esp_deep_sleep_start()
+  // keeps the validated config in RTC slow memory; begin() then restores
+  // it on wake with no filesystem access. Any other reset, or a CRC,
+  // layout or generation mismatch (new firmware), falls back to flash.
+  // The image is used once and dropped by every save() and load().
+  void enableRtcCache(uint32_t generation = DICE_CONFIG_RTC_GENERATION);
+  bool storeToRtc();
+  void invalidateRtc();
+  bool wasRestoredFromRtc();
+  
+  // Raw-partition mode: begin() reads the newest binary record straight
+  // from the memory-mapped partition (no mount, no parsing) and save()
+  // appends a new record. If the partition holds no valid record yet,
+  // begin() loads the text file as usual and seeds the partition with it.
+  // save(filename) still writes a text file.
+  bool enablePartition(const char* label = DICE_CONFIG_PARTITION_LABEL);
+  DiceConfigPartition& getPartition();
+  
+  // Signed-config mode: files must carry a valid HMAC-SHA256
+  // "signature=" line, verified in the same pass as parsing.
+  // save() appends the signature. Pass nullptr to disable.
+  bool setSigningKey(const uint8_t* key, size_t len);
+  
+  // Timing of the last load() and the share spent on the signature check
+  unsigned long getLastLoadMicros();
+  unsigned long getLastAuthMicros();
+  
   // Reset to default values
   void setDefaults();
   
+  // Replace the built-in defaults, e.g. with a constexpr DiceConfig
+  // generated by extras/tools/dice_config_compile. Also becomes the
+  // current config; files loaded later only override the keys they set.
+  void setBaseConfig(const DiceConfig& base);
+  const DiceConfig& getBaseConfig();
+  
   // Validate current configuration
   bool validate();
   
@@ -59,6 +213,27 @@ public:
   DiceConfig& getConfig();
   void setConfig(const DiceConfig& newConfig);
   
+  // Lock-free snapshot of the last published config. Safe to call from
+  // any task or core while another one loads or modifies the config.
+  DiceConfig snapshot() const;
+  
+  // Publish edits made through getConfig() to snapshot() readers
+  // (load, setConfig, setDefaults, save and the setters publish themselves)
+  void publish();
+  
+  // Incremented on every publish
+  uint32_t getGeneration() const;
+  
+  // Register for changes to a set of DICE_FIELD_* / DICE_GROUP_* bits.
+  // Observers run on the publishing task, once per change set, after
+  // the writer lock is released (they may call setters or save()).
+  // Returns an id for removeObserver(), or -1 if all slots are used.
+  int addObserver(uint32_t fields, DiceConfigObserver observer, void* context = nullptr);
+  void removeObserver(int id);
+  
+  // Fields that changed in the most recent publish
+  uint32_t getChangedFields();
+  
   // Individual field setters (convenience methods)
   void setDiceId(const char* id);
   void setDeviceAMac(const uint8_t* mac);
@@ -70,35 +245,283 @@ public:
   void setAlwaysSeven(bool value);
   
   // Utility functions
-  void printConfig();
+  // The report is formatted into one buffer and written in a single call.
+  // Use DiceConfigReport to drain it a few bytes per loop() pass instead.
+  void printConfig(Print& out = Serial);
+  void printConfig(DiceConfigWriter writer, void* context = nullptr);
+  size_t formatConfig(char* buffer, size_t size);
   void printMacAddress(const uint8_t* mac);
   String macToString(const uint8_t* mac);
   
   // Get last error message
   const char* getLastError();
   
-  // Enable/disable verbose logging
+  // Enable/disable verbose logging. Messages are queued in a small
+  // ring buffer instead of being printed; call drainLog() from loop()
+  // or a low-priority task to format and output them.
   void setVerbose(bool enabled);
+  size_t drainLog(Print& out = Serial, size_t maxRecords = DICE_CONFIG_LOG_SIZE);
   
   // Get the currently loaded config filename
   const char* getConfigPath();
+  
+  // Auto-detection patterns, ';'-separated, highest priority first
+  // (default DICE_CONFIG_PATTERNS, "*_config.txt"). Exactly one file
+  // may match the best-priority pattern that matches anything.
+  // See DiceConfigPattern.h for the syntax.
+  bool setConfigPatterns(const char* patterns);
+  const DicePatternSet& getConfigPatterns();
+  
+  // Fleet images: when several files match, begin() picks the one whose
+  // deviceA/B1/B2 MAC is this device's MAC. It looks the MAC up in the
+  // sorted index DICE_CONFIG_MACIDX_PATH before scanning anything, so
+  // boot cost barely grows with the number of configs. The index comes
+  // from extras/tools/dice_config_macindex or is rebuilt on the device
+  // when it is missing or stale (up to DICE_CONFIG_MACIDX_BUILD_MAX MACs).
+  void enableMacSelection(bool enabled = true);
+  bool rebuildMacIndex();
+  
+  // This device's MAC: esp_read_mac(ESP_MAC_WIFI_STA) unless set here
+  // (on host it must be set)
+  void setDeviceMac(const uint8_t* mac);
+  bool getDeviceMac(uint8_t* mac);
+  
+  // DiceDeviceRole of this device in the loaded config
+  uint8_t getDeviceRole();
+  
+  // Auto-detection reuses the index in DICE_CONFIG_INDEX_PATH while the
+  // directory and the indexed files are unchanged. LittleFS has no
+  // directory timestamp, so code that adds a config file next to an
+  // existing one outside the library (an upload handler) must call this
+  // to force a rescan. save() to a new matching file calls it itself.
+  void invalidateConfigIndex();
+  
+  // Storage backend (e.g. DicePosixStorage::setRoot() on host)
+  DiceConfigStorage& getStorage();
 
 private:
   DiceConfig _config;
-  char _configPath[64];
+  DiceConfig _baseConfig;
+  DiceConfigStorage _storage;
+  char _configPath[DICE_CONFIG_PATH_MAX];
   char _lastError[128];
   bool _verbose;
+  DiceConfigLog _log;
+  void logEvent(uint8_t code, int32_t arg0 = 0, int32_t arg1 = 0, const char* text = nullptr);
+  
+  // Double-buffered published copies for snapshot() readers
+  static const size_t SNAPSHOT_WORDS = (sizeof(DiceConfig) + 3) / 4;
+  struct SnapshotBuffer {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> words[SNAPSHOT_WORDS];
+  };
+  SnapshotBuffer _snapshots[2];
+  std::atomic<uint8_t> _publishIndex;
+  std::atomic<uint32_t> _generation;
+  
+  // Change observers; _fieldSubscribers[bit] is the set of observer
+  // slots interested in that field, rebuilt on add/remove
+  struct Observer {
+    DiceConfigObserver fn;
+    void* context;
+    uint32_t fields;
+  };
+  Observer _observers[DICE_CONFIG_MAX_OBSERVERS];
+  uint32_t _fieldSubscribers[DICE_FIELD_COUNT];
+  DiceConfig _lastPublished;
+  uint32_t _changedFields;
+  uint32_t _unnotifiedFields;     // Published, observers not yet called
+  void rebuildSubscribers();
+  static uint32_t diffConfig(const DiceConfig& a, const DiceConfig& b);
+  
+  // Fingerprint of the last successfully loaded file
+  bool _loadedValid;
+  uint32_t _loadedPathHash;
+  size_t _loadedSize;
+  time_t _loadedWriteTime;
+  uint32_t _loadedContentHash;
+  
+  // Binary image of a validated config, tagged with its source file
+  struct ConfigSlot {
+    uint32_t magic;
+    uint32_t sourcePathHash;
+    uint32_t sourceSize;
+    uint32_t sourceWriteTime;
+    uint32_t sourceContentHash;
+    DiceConfig config;
+    uint32_t imageHash;
+  };
+  
+  // Slot pointer and boot counter, persisted separately from the images
+  struct SlotState {
+    uint32_t magic;
+    uint8_t active;
+    uint8_t confirmed;
+    uint8_t bootCount;
+    uint8_t reserved;
+    uint32_t rejectedContentHash;
+    uint32_t rejectedSize;
+    uint32_t rejectedWriteTime;
+  };
+  
+  bool _slotsEnabled;
+  uint8_t _maxBootAttempts;
+  SlotState _slotState;
+  
+  // Slot helpers
+  bool beginFromSlots();
+  bool readSlot(uint8_t index, ConfigSlot& slot);
+  bool writeSlot(uint8_t index, const ConfigSlot& slot);
+  void readSlotState();
+  bool writeSlotState();
+  void storeTrialSlot(size_t fileSize, time_t writeTime);
+  void countBootAttempt();
+  
+  // RTC cache state
+  bool _rtcEnabled;
+  bool _rtcRestored;
+  uint32_t _rtcGeneration;
+  bool restoreFromRtc(const char* configPath);
+  
+  // Raw-partition state
+  DiceConfigPartition _partition;
+  bool _partitionEnabled;
+  bool restoreFromPartition();
+  bool storeToPartition();
+  
+  // Storage is mounted on first file access (see ensureMounted())
+  bool _formatOnFail;
+  bool _mountLogged;
+  bool ensureMounted();
+  
+  // Signed-config state
+  uint8_t _signingKey[64];
+  size_t _signingKeyLen;
+  unsigned long _lastLoadMicros;
+  unsigned long _lastAuthMicros;
+  bool signFile(const char* filename);
+  
+  // Serializes writers (API calls and the async worker); recursive
+  class WriteGuard;
+#if defined(ESP_PLATFORM)
+  SemaphoreHandle_t _writeLock;
+#else
+  std::recursive_mutex _writeLock;
+#endif
+  uint8_t _writeDepth;            // Recursion depth of the owner
+  void lockWriter();
+  
+  // Open beginUpdate() nesting depth, the thread that opened it and the
+  // config to restore on abort
+  uint8_t _updateDepth;
+#if !defined(ESP_PLATFORM)
+  std::thread::id _updateOwner;
+#endif
+  DiceConfig _updateBase;
+  bool ownsUpdate() const;
+  void unlockWriter();
+  bool writeConfigFile(const char* filename);
+  
+  // Async worker state, guarded by _asyncLock
+  static const uint8_t ASYNC_LOAD = 0x01;
+  static const uint8_t ASYNC_SAVE = 0x02;
+  static const uint8_t ASYNC_BEGIN = 0x04;
+  static const size_t ASYNC_MAX_CALLBACKS = 4;
+  struct AsyncCallback {
+    DiceConfigCallback fn;
+    void* context;
+  };
+  struct AsyncQueue {
+    AsyncCallback callbacks[ASYNC_MAX_CALLBACKS];
+    uint8_t count;
+  };
+  uint8_t _asyncPending;
+  uint8_t _asyncOrder[3];         // Pending ops, first queued first
+  bool _asyncStop;
+  bool _asyncFailed;
+  AsyncQueue _asyncQueues[3];     // Load, save, begin
+  char _beginPath[DICE_CONFIG_PATH_MAX];
+  bool _beginHasPath;
+  bool _beginRestored;            // Queued begin only runs the callbacks
+  std::atomic<uint8_t> _asyncState;
+#if defined(ESP_PLATFORM)
+  SemaphoreHandle_t _asyncLock;
+  TaskHandle_t _asyncTask;
+  static void asyncTaskEntry(void* arg);
+#else
+  std::mutex _asyncLock;
+  std::condition_variable _asyncWake;
+  std::thread _asyncThread;
+  bool _asyncStarted;
+#endif
+  bool queueAsync(uint8_t op, DiceConfigCallback callback, void* context);
+  bool startAsyncWorker();
+  void stopAsyncWorker();
+  void asyncLoop();
+  void lockAsync();
+  void unlockAsync();
+  static uint8_t asyncQueueIndex(uint8_t op);
+  
+  // begin() after the RTC check; also run by the worker for beginAsync()
+  bool beginFromStorage(const char* configPath);
+  bool beginInBackground();
   
   // Auto-detection helper
   bool findConfigFile(char* foundPath, size_t maxLen);
   
+  // Persisted auto-detection index (header, then up to
+  // DICE_CONFIG_INDEX_ENTRIES matching files)
+  struct ConfigIndexEntry {
+    char name[64];            // Path relative to the root
+    uint32_t size;
+    uint32_t lastWrite;
+    char diceId[16];          // Filled in after the file was loaded
+  };
+  struct ConfigIndex {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t hasStamp;
+    uint8_t count;            // Files matching the best pattern (saturates)
+    uint32_t dirStamp;
+    uint32_t patternHash;
+    uint32_t filesHash;       // DiceMacIndex::fileHash() sum, all matches
+    ConfigIndexEntry entries[DICE_CONFIG_INDEX_ENTRIES];
+  };
+  ConfigIndex _index;
+  bool _indexValid;
+  DicePatternSet _patterns;
+  bool indexDirStamp(uint32_t& stamp);
+  bool readConfigIndex();
+  bool checkConfigIndex();
+  bool sameConfigIndex(const ConfigIndex& stored);
+  bool scanConfigFiles();
+  static void indexVisitor(const char* path, int priority, const DiceFileInfo& info,
+                           void* context);
+  
+  // MAC selection state
+  bool _macSelection;
+  bool _macSelected;          // _configPath came from the MAC index
+  bool _deviceMacSet;
+  uint8_t _deviceMac[6];
+  uint8_t _deviceRole;
+  bool findConfigByMac(char* foundPath, size_t maxLen);
+  bool matchesDeviceMac();
+  bool writeConfigIndex();
+  void updateIndexedDiceId();
+  
   // Internal parsing functions
-  bool parseMacAddress(const char* str, uint8_t* mac);
-  bool parseBool(const char* str);
-  void trim(char* str);
+  bool parseFile(DiceConfigStorage::File& file, uint32_t* contentHash,
+                 size_t limit = SIZE_MAX, const char* defaultId = nullptr);
+  uint32_t hashFile(DiceConfigStorage::File& file);
+  static uint32_t hashBytes(uint32_t hash, const void* data, size_t len);
+  static void formatMac(const uint8_t* mac, char* buffer);
+  bool parseHex(const char* str, uint8_t* out, size_t len);
+  static int hexDigit(char c);
   void calculateChecksum(DiceConfig& config);
   bool validateChecksum(const DiceConfig& config);
-  void setError(const char* error);
+  // The log keeps a pointer to error unless literal is false, in which
+  // case it gets a (truncated) copy; getLastError() always has all of it
+  void setError(const char* error, bool literal = true);
   
   // Default configuration values
   void initDefaultConfig();
@@ -0,0 +1,309 @@
+/*
+ * DiceConfigManifest - Many configs in one file, with an offset index
+ */
+
+#include "DiceConfigManifest.h"
+
+static const uint32_t MANIFEST_INDEX_MAGIC = 0x44434D53UL;  // "DCMS"
+static const uint16_t MANIFEST_INDEX_VERSION = 2;
+
+// Receives each section found by scanSections()
+typedef void (*SectionSink)(const DiceManifestSection& section, const DiceConfig& config,
+                            void* context);
+
+// Sections of an index under construction
+struct SectionList {
+  DiceManifestSection* sections;
+  size_t count;
+  size_t capacity;
+  bool failed;
+};
+
+// Adapts a SectionVisitor to scanSections()
+struct SectionVisit {
+  DiceManifest::SectionVisitor visit;
+  void* context;
+};
+
+// One sequential pass: parse each section and report where it is. The
+// unnamed section before the first header counts only if it sets a key.
+// A header with a bad name ends a section without starting one.
+static size_t scanSections(DiceConfigStorage::File& file, SectionSink sink, void* context) {
+  DiceLineReader reader(file);
+  char line[128];
+  char name[sizeof(DiceManifestSection::name)];
+  size_t count = 0;
+  size_t lineStart = 0;
+  bool hasKeys = false;
+  bool skipping = false;
+
+  DiceManifestSection section;
+  memset(&section, 0, sizeof(section));
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+
+  for (;;) {
+    bool more = reader.readLine(line, sizeof(line)) >= 0;
+    bool header = more && DiceManifest::isHeader(line);
+
+    if (!more || header) {
+      if (section.headerLength > 0 || hasKeys) {
+        if (section.headerLength == 0) {
+          memcpy(section.name, config.diceId, strnlen(config.diceId, sizeof(section.name) - 1));
+        }
+        section.length = (uint32_t)(lineStart - section.offset);
+        sink(section, config, context);
+        count++;
+      }
+      if (!more) {
+        break;
+      }
+
+      memset(&section, 0, sizeof(section));
+      DiceConfigParser::setDefaults(config);
+      hasKeys = false;
+      skipping = !DiceManifest::parseHeader(line, name, sizeof(name));
+      if (!skipping) {
+        strcpy(section.name, name);
+        section.offset = (uint32_t)lineStart;
+        section.headerLength = (uint16_t)(reader.position() - lineStart);
+        strcpy(config.diceId, name);
+      }
+    } else if (!skipping && DiceConfigParser::parseLine(line, config) == DICE_PARSE_OK) {
+      hasKeys = true;
+    }
+    lineStart = reader.position();
+  }
+  return count;
+}
+
+static void collectSection(const DiceManifestSection& section, const DiceConfig& config,
+                           void* context) {
+  (void)config;
+  SectionList& list = *(SectionList*)context;
+  if (section.name[0] == '\0' || list.failed) {
+    return;
+  }
+  if (list.count == list.capacity) {
+    size_t capacity = list.capacity ? list.capacity * 2 : 16;
+    DiceManifestSection* grown =
+      (DiceManifestSection*)realloc(list.sections, capacity * sizeof(DiceManifestSection));
+    if (grown == nullptr) {
+      list.failed = true;
+      return;
+    }
+    list.sections = grown;
+    list.capacity = capacity;
+  }
+  list.sections[list.count++] = section;
+}
+
+static void visitSection(const DiceManifestSection& section, const DiceConfig& config,
+                         void* context) {
+  SectionVisit& visit = *(SectionVisit*)context;
+  visit.visit(section.name, config, visit.context);
+}
+
+bool DiceManifest::indexPath(const char* manifestPath, char* path, size_t size) {
+  int written = snprintf(path, size, "%s%s", manifestPath, DICE_CONFIG_MANIFEST_INDEX_SUFFIX);
+  return written > 0 && (size_t)written < size;
+}
+
+bool DiceManifest::buildIndex(DiceConfigStorage& storage, const char* manifestPath) {
+  char path[72];
+  if (!indexPath(manifestPath, path, sizeof(path))) {
+    return false;
+  }
+
+  DiceConfigStorage::File file;
+  if (!storage.open(file, manifestPath, "r")) {
+    return false;
+  }
+  size_t manifestSize = file.size();
+  time_t manifestWrite = file.lastWrite();
+  SectionList list = { nullptr, 0, 0, false };
+  scanSections(file, collectSection, &list);
+  file.close();
+
+  bool ok = !list.failed;
+  if (ok) {
+    // qsort() must not see the null list of an empty manifest
+    if (list.count > 1) {
+      qsort(list.sections, list.count, sizeof(DiceManifestSection), compareSections);
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MANIFEST_INDEX_MAGIC;
+    header.version = MANIFEST_INDEX_VERSION;
+    header.recordSize = sizeof(DiceManifestSection);
+    header.count = (uint32_t)list.count;
+    header.manifestSize = (uint32_t)manifestSize;
+    header.manifestWrite = (uint32_t)manifestWrite;
+
+    size_t bytes = list.count * sizeof(DiceManifestSection);
+    ok = storage.open(file, path, "w");
+    if (ok) {
+      ok = file.write(&header, sizeof(header)) == sizeof(header) &&
+           (bytes == 0 || file.write(list.sections, bytes) == bytes);
+      file.close();
+    }
+  }
+  free(list.sections);
+  return ok;
+}
+
+DiceManifest::FindResult DiceManifest::find(DiceConfigStorage& storage, const char* manifestPath,
+                                            size_t manifestSize, time_t manifestWrite,
+                                            const char* name, DiceManifestSection& section) {
+  char path[72];
+  DiceConfigStorage::File file;
+  if (!indexPath(manifestPath, path, sizeof(path)) || !storage.open(file, path, "r")) {
+    return NO_INDEX;
+  }
+
+  Header header;
+  if (file.read(&header, sizeof(header)) != (int)sizeof(header) ||
+      header.magic != MANIFEST_INDEX_MAGIC || header.version != MANIFEST_INDEX_VERSION ||
+      header.recordSize != sizeof(DiceManifestSection) ||
+      header.manifestSize != manifestSize ||
+      header.manifestWrite != (uint32_t)manifestWrite ||
+      file.size() != sizeof(header) + (size_t)header.count * sizeof(DiceManifestSection)) {
+    file.close();
+    return NO_INDEX;
+  }
+
+  // Lower bound of name
+  size_t low = 0;
+  size_t high = header.count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (!file.seek(sizeof(header) + mid * sizeof(section)) ||
+        file.read(&section, sizeof(section)) != (int)sizeof(section)) {
+      file.close();
+      return NO_INDEX;
+    }
+    section.name[sizeof(section.name) - 1] = '\0';
+    if (strcmp(section.name, name) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  FindResult result = NOT_FOUND;
+  if (low < header.count && file.seek(sizeof(header) + low * sizeof(section)) &&
+      file.read(&section, sizeof(section)) == (int)sizeof(section)) {
+    section.name[sizeof(section.name) - 1] = '\0';
+    if (strcmp(section.name, name) == 0) {
+      result = FOUND;
+    }
+  }
+  file.close();
+  return result;
+}
+
+bool DiceManifest::checkHeader(DiceConfigStorage::File& file, const DiceManifestSection& section) {
+  if (section.headerLength == 0) {
+    return true;
+  }
+
+  char line[130];
+  char name[sizeof(section.name)];
+  if (section.headerLength >= sizeof(line) ||
+      file.read(line, section.headerLength) != (int)section.headerLength) {
+    return false;
+  }
+  line[section.headerLength] = '\0';
+  char* newline = strchr(line, '\n');
+  if (newline) {
+    *newline = '\0';
+  }
+  return parseHeader(line, name, sizeof(name)) && strcmp(name, section.name) == 0;
+}
+
+bool DiceManifest::checkEnd(DiceConfigStorage::File& file, const DiceManifestSection& section) {
+  size_t end = (size_t)section.offset + section.length;
+  size_t size = file.size();
+  if (section.length == 0 || end > size) {
+    return false;
+  }
+  if (end == size) {
+    return true;
+  }
+
+  // The last byte of the section ends a line and the next line is a header
+  char line[129];
+  if (!file.seek(end - 1) || file.read(line, 1) != 1 || line[0] != '\n') {
+    return false;
+  }
+  int count = file.read(line, sizeof(line) - 1);
+  if (count <= 0) {
+    return false;
+  }
+  line[count] = '\0';
+  char* newline = strchr(line, '\n');
+  if (newline) {
+    *newline = '\0';
+  }
+  return isHeader(line);
+}
+
+size_t DiceManifest::forEach(DiceConfigStorage& storage, const char* manifestPath,
+                             SectionVisitor visit, void* context) {
+  DiceConfigStorage::File file;
+  if (!storage.open(file, manifestPath, "r")) {
+    return 0;
+  }
+  SectionVisit adapter = { visit, context };
+  size_t count = scanSections(file, visitSection, &adapter);
+  file.close();
+  return count;
+}
+
+bool DiceManifest::isHeader(const char* line) {
+  while (*line == ' ' || *line == '\t') line++;
+  if (*line != '[') {
+    return false;
+  }
+  const char* end = strchr(line + 1, ']');
+  if (end == nullptr) {
+    return false;
+  }
+
+  // Nothing but blanks after ']'
+  for (const char* c = end + 1; *c != '\0'; c++) {
+    if (*c != ' ' && *c != '\t' && *c != '\r') {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DiceManifest::parseHeader(const char* line, char* name, size_t size) {
+  if (!isHeader(line)) {
+    return false;
+  }
+  const char* start = strchr(line, '[') + 1;
+  const char* end = strchr(start, ']');
+  while (start < end && (*start == ' ' || *start == '\t')) start++;
+  while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+  size_t length = end - start;
+  if (length == 0 || length >= size) {
+    return false;
+  }
+  memcpy(name, start, length);
+  name[length] = '\0';
+  return true;
+}
+
+// By name; the first section of a name in the file wins
+int DiceManifest::compareSections(const void* a, const void* b) {
+  const DiceManifestSection& x = *(const DiceManifestSection*)a;
+  const DiceManifestSection& y = *(const DiceManifestSection*)b;
+  int result = strncmp(x.name, y.name, sizeof(x.name));
+  if (result == 0) {
+    result = x.offset < y.offset ? -1 : (x.offset > y.offset ? 1 : 0);
+  }
+  return result;
+}
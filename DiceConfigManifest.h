@@ -0,0 +1,97 @@
+/*
+ * DiceConfigManifest - Many configs in one file, with an offset index
+ * A manifest holds one section per dice, each starting with a [name]
+ * line and otherwise written like a *_config.txt:
+ *
+ *   [BART1]
+ *   deviceA_mac=24:6F:28:00:00:01
+ *   ...
+ *   [TEST1]
+ *   ...
+ *
+ * A section's diceId defaults to its name. Lines before the first [name]
+ * form an unnamed section keyed by its diceId, so a plain config file is
+ * a valid one-section manifest. A [name] line whose name is empty or
+ * longer than 15 characters still ends the section before it; the lines
+ * up to the next header are skipped.
+ *
+ * The sidecar index "<manifest>.idx" lists the sections sorted by name,
+ * with offset and length. Finding a section is a binary search of seeks
+ * in the index; loading it is one seek and reads bounded to the section.
+ * forEach() streams the whole manifest sequentially instead.
+ */
+
+#ifndef DICE_CONFIG_MANIFEST_H
+#define DICE_CONFIG_MANIFEST_H
+
+#include "DiceConfigPlatform.h"
+#include "DiceConfigParser.h"
+#include "DiceConfigStorage.h"
+
+#define DICE_CONFIG_MANIFEST_INDEX_SUFFIX ".idx"
+
+struct DiceManifestSection {
+  char name[16];              // NUL-terminated
+  uint32_t offset;            // Of the [name] line (or the file start)
+  uint32_t length;            // Whole section, header line included
+  uint16_t headerLength;      // 0 for the unnamed section
+  uint16_t reserved;
+};
+
+class DiceManifest {
+public:
+  enum FindResult {
+    FOUND,
+    NOT_FOUND,
+    NO_INDEX                  // Missing, unreadable or stale index
+  };
+
+  // Called by forEach() for each section, parsed from the library defaults
+  typedef void (*SectionVisitor)(const char* name, const DiceConfig& config, void* context);
+
+  // "<manifestPath>.idx"; false if it doesn't fit
+  static bool indexPath(const char* manifestPath, char* path, size_t size);
+
+  // Stream the manifest once and write its sorted index
+  static bool buildIndex(DiceConfigStorage& storage, const char* manifestPath);
+
+  // Binary search for section name. manifestSize and manifestWrite are
+  // the manifest's current size and last-write time; an index built for
+  // another size or time is stale.
+  static FindResult find(DiceConfigStorage& storage, const char* manifestPath,
+                         size_t manifestSize, time_t manifestWrite, const char* name,
+                         DiceManifestSection& section);
+
+  // With file positioned at section.offset: does it start with the
+  // expected [name] line? Leaves file at the first line after it.
+  static bool checkHeader(DiceConfigStorage::File& file, const DiceManifestSection& section);
+
+  // Does section end at the end of file or right before a header line,
+  // as the index says? Moves the file position.
+  static bool checkEnd(DiceConfigStorage::File& file, const DiceManifestSection& section);
+
+  // Parse every section in file order; returns the number of sections
+  static size_t forEach(DiceConfigStorage& storage, const char* manifestPath,
+                        SectionVisitor visit, void* context);
+
+  // Is line shaped like a header: '[', anything, ']', then only blanks?
+  static bool isHeader(const char* line);
+
+  // Is line a "[name]" header with a usable name? Copies the name
+  // (trimmed) if so.
+  static bool parseHeader(const char* line, char* name, size_t size);
+
+private:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t count;
+    uint32_t manifestSize;
+    uint32_t manifestWrite;
+  };
+
+  static int compareSections(const void* a, const void* b);
+};
+
+#endif // DICE_CONFIG_MANIFEST_H
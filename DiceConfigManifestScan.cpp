@@ -0,0 +1,545 @@
+/*
+ * DiceConfigManifestScan - Parallel manifest parsing on the host
+ */
+
+#include "DiceConfigManifestScan.h"
+
+#if defined(DICE_CONFIG_HOST)
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define DICE_SCAN_X86 1
+#endif
+
+static const size_t SCAN_BLOCK = 32;
+static const size_t SCAN_RUN_BLOCKS = 64;  // Classified per call (2 KB)
+static const size_t SCAN_CHUNKS_PER_THREAD = 4;
+
+// What DiceLineReader returns per readLine() for the char[128] buffer of
+// scanSections(); longer lines come out in pieces of this size
+static const size_t SCAN_PIECE = 127;
+
+// Bit i is set if byte i of the block is that character
+struct BlockMasks {
+  uint32_t newlines;
+  uint32_t equals;
+  uint32_t hashes;
+};
+
+typedef void (*Classifier)(const char* data, size_t blocks, BlockMasks* masks);
+
+static void classifyScalar(const char* data, size_t blocks, BlockMasks* masks) {
+  for (size_t b = 0; b < blocks; b++, data += SCAN_BLOCK) {
+    uint32_t newlines = 0;
+    uint32_t equals = 0;
+    uint32_t hashes = 0;
+    for (size_t i = 0; i < SCAN_BLOCK; i++) {
+      uint32_t bit = (uint32_t)1 << i;
+      newlines |= data[i] == '\n' ? bit : 0;
+      equals |= data[i] == '=' ? bit : 0;
+      hashes |= data[i] == '#' ? bit : 0;
+    }
+    masks[b].newlines = newlines;
+    masks[b].equals = equals;
+    masks[b].hashes = hashes;
+  }
+}
+
+#if defined(DICE_SCAN_X86)
+__attribute__((target("sse2")))
+static uint32_t matchSse2(__m128i low, __m128i high, __m128i c) {
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(low, c)) |
+         (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(high, c)) << 16;
+}
+
+__attribute__((target("sse2")))
+static void classifySse2(const char* data, size_t blocks, BlockMasks* masks) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i equals = _mm_set1_epi8('=');
+  const __m128i hash = _mm_set1_epi8('#');
+  for (size_t b = 0; b < blocks; b++, data += SCAN_BLOCK) {
+    __m128i low = _mm_loadu_si128((const __m128i*)data);
+    __m128i high = _mm_loadu_si128((const __m128i*)(data + 16));
+    masks[b].newlines = matchSse2(low, high, newline);
+    masks[b].equals = matchSse2(low, high, equals);
+    masks[b].hashes = matchSse2(low, high, hash);
+  }
+}
+
+__attribute__((target("avx2")))
+static void classifyAvx2(const char* data, size_t blocks, BlockMasks* masks) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i equals = _mm256_set1_epi8('=');
+  const __m256i hash = _mm256_set1_epi8('#');
+  for (size_t b = 0; b < blocks; b++, data += SCAN_BLOCK) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i*)data);
+    masks[b].newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline));
+    masks[b].equals = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, equals));
+    masks[b].hashes = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, hash));
+  }
+}
+#endif
+
+static Classifier classifierFor(DiceScanIsa isa) {
+#if defined(DICE_SCAN_X86)
+  if (isa == DICE_SCAN_AVX2) {
+    return classifyAvx2;
+  }
+  if (isa == DICE_SCAN_SSE2) {
+    return classifySse2;
+  }
+#endif
+  (void)isa;
+  return classifyScalar;
+}
+
+// Sections of one chunk, grown with realloc
+struct ChunkResult {
+  DiceManifestSection* sections;
+  DiceConfig* configs;
+  size_t count;
+  size_t capacity;
+  bool failed;
+};
+
+// Does the line at text start with a [name] line? Only its first piece
+// counts, as DiceLineReader would hand it out. name is left empty for a
+// header with a bad name.
+static bool isHeaderLine(const char* text, size_t length, char* name) {
+  char line[SCAN_PIECE + 1];
+  if (length > SCAN_PIECE) {
+    length = SCAN_PIECE;
+  }
+  size_t blank = 0;
+  while (blank < length && (text[blank] == ' ' || text[blank] == '\t')) blank++;
+  if (blank == length || text[blank] != '[') {
+    return false;
+  }
+  memcpy(line, text, length);
+  line[length] = '\0';
+  if (!DiceManifest::isHeader(line)) {
+    return false;
+  }
+  if (!DiceManifest::parseHeader(line, name, sizeof(DiceManifestSection::name))) {
+    name[0] = '\0';
+  }
+  return true;
+}
+
+// The first header line (bad names included) at or after from; size if none
+static size_t nextBoundary(const char* data, size_t size, size_t from) {
+  char name[sizeof(DiceManifestSection::name)];
+  size_t pos = from;
+  if (pos > 0 && pos < size && data[pos - 1] != '\n') {
+    const char* newline = (const char*)memchr(data + pos, '\n', size - pos);
+    pos = newline ? (size_t)(newline - data) + 1 : size;
+  }
+  while (pos < size) {
+    const char* newline = (const char*)memchr(data + pos, '\n', size - pos);
+    size_t end = newline ? (size_t)(newline - data) : size;
+    if (isHeaderLine(data + pos, end - pos, name)) {
+      return pos;
+    }
+    pos = end + 1;
+  }
+  return size;
+}
+
+// Parses [begin, end) of the mapped file exactly like scanSections()
+// parses a file. Chunks other than the first start at a [name] line.
+class ChunkScanner {
+public:
+  ChunkScanner(const char* data, size_t begin, size_t end, Classifier classify,
+               ChunkResult& result)
+    : _data(data), _begin(begin), _end(end), _classify(classify), _result(result),
+      _hasKeys(false), _skipping(false) {
+    memset(&_section, 0, sizeof(_section));
+    _section.offset = (uint32_t)begin;
+    DiceConfigParser::setDefaults(_config);
+  }
+
+  void run();
+
+private:
+  const char* _data;
+  size_t _begin;
+  size_t _end;
+  Classifier _classify;
+  ChunkResult& _result;
+
+  DiceManifestSection _section;
+  DiceConfig _config;
+  bool _hasKeys;
+  bool _skipping;               // After a header with a bad name
+
+  void line(size_t start, size_t end, bool terminated, bool equals, bool hashes);
+  void piece(size_t start, size_t end, size_t next, bool equals, bool hashes);
+  void flush(size_t end);
+  bool contains(size_t start, size_t end, char c) const {
+    return memchr(_data + start, c, end - start) != nullptr;
+  }
+};
+
+void ChunkScanner::run() {
+  BlockMasks masks[SCAN_RUN_BLOCKS];
+  size_t lineStart = _begin;
+  bool equals = false;
+  bool hashes = false;
+
+  size_t pos = _begin;
+  while (pos < _end) {
+    size_t blocks = (_end - pos) / SCAN_BLOCK;
+    if (blocks > SCAN_RUN_BLOCKS) {
+      blocks = SCAN_RUN_BLOCKS;
+    }
+    if (blocks > 0) {
+      _classify(_data + pos, blocks, masks);
+    } else {
+      // The tail, padded with NULs (which match nothing)
+      char tail[SCAN_BLOCK];
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, _data + pos, _end - pos);
+      _classify(tail, 1, masks);
+      blocks = 1;
+    }
+
+    for (size_t b = 0; b < blocks; b++, pos += SCAN_BLOCK) {
+      // Bits of this block that belong to the current line
+      uint32_t lineBits = 0xFFFFFFFFUL;
+      uint32_t newlines = masks[b].newlines;
+      while (newlines != 0) {
+        unsigned bit = (unsigned)__builtin_ctz(newlines);
+        uint32_t before = lineBits & (((uint32_t)1 << bit) - 1);
+        equals = equals || (masks[b].equals & before) != 0;
+        hashes = hashes || (masks[b].hashes & before) != 0;
+        line(lineStart, pos + bit, true, equals, hashes);
+
+        lineStart = pos + bit + 1;
+        equals = false;
+        hashes = false;
+        lineBits = ~(((uint32_t)2 << bit) - 1);
+        newlines &= newlines - 1;
+      }
+      equals = equals || (masks[b].equals & lineBits) != 0;
+      hashes = hashes || (masks[b].hashes & lineBits) != 0;
+    }
+  }
+
+  // A last line without '\n' (end of file)
+  if (lineStart < _end) {
+    line(lineStart, _end, false, equals, hashes);
+  }
+  flush(_end);
+}
+
+void ChunkScanner::line(size_t start, size_t end, bool terminated, bool equals, bool hashes) {
+  size_t next = terminated ? end + 1 : end;
+  if (end - start >= SCAN_PIECE) {
+    // Full pieces don't take the newline; one that ends right at it is
+    // followed by an empty piece that does
+    while (end - start >= SCAN_PIECE) {
+      size_t pieceEnd = start + SCAN_PIECE;
+      piece(start, pieceEnd, pieceEnd, contains(start, pieceEnd, '='),
+            contains(start, pieceEnd, '#'));
+      start = pieceEnd;
+    }
+    equals = contains(start, end, '=');
+    hashes = contains(start, end, '#');
+  }
+  if (start < end || terminated) {
+    piece(start, end, next, equals, hashes);
+  }
+}
+
+// One readLine() worth: [start, end), the reader is at next afterwards
+void ChunkScanner::piece(size_t start, size_t end, size_t next, bool equals, bool hashes) {
+  const char* text = _data + start;
+  size_t length = end - start;
+
+  char name[sizeof(_section.name)];
+  if (isHeaderLine(text, length, name)) {
+    flush(start);
+    memset(&_section, 0, sizeof(_section));
+    DiceConfigParser::setDefaults(_config);
+    _hasKeys = false;
+    _skipping = name[0] == '\0';
+    if (!_skipping) {
+      strcpy(_section.name, name);
+      _section.offset = (uint32_t)start;
+      _section.headerLength = (uint16_t)(next - start);
+      strcpy(_config.diceId, name);
+    }
+    return;
+  }
+
+  // Without '=' a line is blank, a comment or malformed: it sets nothing
+  if (!equals || _skipping) {
+    return;
+  }
+  if (hashes) {
+    size_t first = 0;
+    while (first < length && (text[first] == ' ' || text[first] == '\t' || text[first] == '\r' ||
+                              text[first] == '\n' || text[first] == '\v' || text[first] == '\f')) {
+      first++;
+    }
+    if (first < length && text[first] == '#') {
+      return;
+    }
+  }
+
+  // parseLine() without the copy: the span parser stops at a NUL like
+  // strlen() would, and only the atof() fallback needs a C string
+  DiceLineSpans spans;
+  DiceParseStatus status = DiceConfigParser::parseLineSpan(text, length, _config, spans);
+  if (status == DICE_PARSE_OK && spans.floatParse != DICE_FLOAT_EXACT) {
+    char value[SCAN_PIECE + 1];
+    size_t valueLength = spans.valueEnd - spans.valueStart;
+    memcpy(value, text + spans.valueStart, valueLength);
+    value[valueLength] = '\0';
+    _config.tumbleConstant = atof(value);
+  }
+  if (status == DICE_PARSE_OK) {
+    _hasKeys = true;
+  }
+}
+
+void ChunkScanner::flush(size_t end) {
+  if (_section.headerLength == 0 && !_hasKeys) {
+    return;
+  }
+  if (_section.headerLength == 0) {
+    memcpy(_section.name, _config.diceId, strnlen(_config.diceId, sizeof(_section.name) - 1));
+  }
+  _section.length = (uint32_t)(end - _section.offset);
+
+  ChunkResult& result = _result;
+  if (result.failed) {
+    return;
+  }
+  if (result.count == result.capacity) {
+    size_t capacity = result.capacity ? result.capacity * 2 : 64;
+    DiceManifestSection* sections =
+      (DiceManifestSection*)realloc(result.sections, capacity * sizeof(DiceManifestSection));
+    if (sections == nullptr) {
+      result.failed = true;
+      return;
+    }
+    result.sections = sections;
+    DiceConfig* configs = (DiceConfig*)realloc(result.configs, capacity * sizeof(DiceConfig));
+    if (configs == nullptr) {
+      result.failed = true;
+      return;
+    }
+    result.configs = configs;
+    result.capacity = capacity;
+  }
+  result.sections[result.count] = _section;
+  result.configs[result.count] = _config;
+  result.count++;
+}
+
+// Shared by the workers of one load()
+struct ScanJob {
+  const char* data;
+  const size_t* bounds;       // Chunk i is [bounds[i], bounds[i + 1])
+  size_t chunks;
+  ChunkResult* results;
+  Classifier classify;
+  std::atomic<size_t> next;
+};
+
+static void scanWorker(ScanJob* job) {
+  for (;;) {
+    size_t chunk = job->next.fetch_add(1);
+    if (chunk >= job->chunks) {
+      break;
+    }
+    ChunkScanner scanner(job->data, job->bounds[chunk], job->bounds[chunk + 1], job->classify,
+                         job->results[chunk]);
+    scanner.run();
+  }
+}
+
+DiceManifestScan::DiceManifestScan()
+  : _sections(nullptr), _configs(nullptr), _count(0), _isa(bestIsa()),
+    _chunkSize(DICE_CONFIG_SCAN_CHUNK), _lastError("") {
+}
+
+DiceManifestScan::~DiceManifestScan() {
+  clear();
+}
+
+void DiceManifestScan::clear() {
+  free(_sections);
+  free(_configs);
+  _sections = nullptr;
+  _configs = nullptr;
+  _count = 0;
+}
+
+bool DiceManifestScan::load(const char* manifestPath, unsigned threads) {
+  clear();
+
+  int fd = open(manifestPath, O_RDONLY);
+  if (fd < 0) {
+    return fail("Failed to open manifest");
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return fail("Failed to open manifest");
+  }
+  // Section offsets are 32-bit, like in the index
+  if ((uint64_t)info.st_size > 0xFFFFFFFFULL) {
+    close(fd);
+    return fail("Manifest too large");
+  }
+  size_t size = (size_t)info.st_size;
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return fail("Failed to map manifest");
+  }
+  madvise(map, size, MADV_WILLNEED);
+  const char* data = (const char*)map;
+
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+    if (threads == 0) {
+      threads = 1;
+    }
+  }
+
+  // Cut at [name] lines near even offsets; boundaries may coincide
+  size_t chunks = threads * SCAN_CHUNKS_PER_THREAD;
+  if (chunks > size / _chunkSize) {
+    chunks = size / _chunkSize > 0 ? size / _chunkSize : 1;
+  }
+  std::vector<size_t> bounds(1, 0);
+  for (size_t i = 1; i < chunks; i++) {
+    size_t target = (size_t)((uint64_t)size * i / chunks);
+    if (target < bounds.back()) {
+      target = bounds.back();
+    }
+    size_t bound = nextBoundary(data, size, target);
+    if (bound > bounds.back() && bound < size) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(size);
+  chunks = bounds.size() - 1;
+
+  std::vector<ChunkResult> results(chunks);
+  for (size_t i = 0; i < chunks; i++) {
+    ChunkResult empty = { nullptr, nullptr, 0, 0, false };
+    results[i] = empty;
+  }
+
+  ScanJob job;
+  job.data = data;
+  job.bounds = &bounds[0];
+  job.chunks = chunks;
+  job.results = &results[0];
+  job.classify = classifierFor(_isa);
+  job.next = 0;
+
+  if (threads > chunks) {
+    threads = (unsigned)chunks;
+  }
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; i++) {
+    workers.push_back(std::thread(scanWorker, &job));
+  }
+  scanWorker(&job);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  munmap(map, size);
+
+  // Stitch the chunks together in file order
+  bool ok = true;
+  size_t total = 0;
+  for (size_t i = 0; i < chunks; i++) {
+    ok = ok && !results[i].failed;
+    total += results[i].count;
+  }
+  if (ok && total > 0) {
+    _sections = (DiceManifestSection*)malloc(total * sizeof(DiceManifestSection));
+    _configs = (DiceConfig*)malloc(total * sizeof(DiceConfig));
+    ok = _sections != nullptr && _configs != nullptr;
+  }
+  for (size_t i = 0; i < chunks; i++) {
+    if (ok && results[i].count > 0) {
+      memcpy(_sections + _count, results[i].sections,
+             results[i].count * sizeof(DiceManifestSection));
+      memcpy(_configs + _count, results[i].configs, results[i].count * sizeof(DiceConfig));
+      _count += results[i].count;
+    }
+    free(results[i].sections);
+    free(results[i].configs);
+  }
+  if (!ok) {
+    clear();
+    return fail("Not enough memory for the manifest");
+  }
+  return true;
+}
+
+size_t DiceManifestScan::forEach(DiceManifest::SectionVisitor visit, void* context) const {
+  for (size_t i = 0; i < _count; i++) {
+    visit(_sections[i].name, _configs[i], context);
+  }
+  return _count;
+}
+
+bool DiceManifestScan::setIsa(DiceScanIsa isa) {
+  if (isa > bestIsa()) {
+    return false;
+  }
+  _isa = isa;
+  return true;
+}
+
+DiceScanIsa DiceManifestScan::bestIsa() {
+#if defined(DICE_SCAN_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return DICE_SCAN_AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return DICE_SCAN_SSE2;
+  }
+#endif
+  return DICE_SCAN_SCALAR;
+}
+
+const char* DiceManifestScan::isaName(DiceScanIsa isa) {
+  switch (isa) {
+    case DICE_SCAN_AVX2:
+      return "avx2";
+    case DICE_SCAN_SSE2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+bool DiceManifestScan::fail(const char* error) {
+  _lastError = error;
+  return false;
+}
+
+#endif // DICE_CONFIG_HOST
@@ -0,0 +1,86 @@
+/*
+ * DiceConfigManifestScan - Parallel manifest parsing on the host
+ * For tools and gateways that read fleet manifests with 100k sections
+ * (hundreds of MB), where a byte-at-a-time DiceLineReader is the limit.
+ * The file is mmapped and classified 32 bytes at a time (AVX2 or SSE2
+ * compares, a scalar loop elsewhere) into bit masks of '\n', '=' and '#'.
+ * Lines come straight from the newline mask; lines without '=' and
+ * comment lines can't set a key and are skipped without copying. The rest
+ * go through DiceConfigParser::parseLine() as usual. The file is cut at
+ * [name] lines into chunks that threads parse independently.
+ *
+ * Results match DiceManifest::forEach() and buildIndex(): same sections
+ * in the same order, same offsets and lengths, byte-identical configs,
+ * down to the line reader cutting lines over 127 characters into pieces.
+ * extras/tools/dice_config_manifest_scan checks that (--diff, --fuzz).
+ * Host builds only.
+ */
+
+#ifndef DICE_CONFIG_MANIFEST_SCAN_H
+#define DICE_CONFIG_MANIFEST_SCAN_H
+
+#include "DiceConfigPlatform.h"
+#include "DiceConfigManifest.h"
+
+#if defined(DICE_CONFIG_HOST)
+
+// Smallest chunk handed to a thread
+#ifndef DICE_CONFIG_SCAN_CHUNK
+#define DICE_CONFIG_SCAN_CHUNK (256 * 1024)
+#endif
+
+// Byte classification code paths, slowest first
+enum DiceScanIsa {
+  DICE_SCAN_SCALAR,
+  DICE_SCAN_SSE2,
+  DICE_SCAN_AVX2
+};
+
+class DiceManifestScan {
+public:
+  DiceManifestScan();
+  ~DiceManifestScan();
+
+  // Map manifestPath (a host path) and parse every section on up to
+  // threads threads (0: one per core). Replaces earlier results.
+  bool load(const char* manifestPath, unsigned threads = 0);
+  void clear();
+
+  // Sections in file order, each parsed from the library defaults
+  size_t size() const { return _count; }
+  const DiceManifestSection& section(size_t index) const { return _sections[index]; }
+  const DiceConfig& config(size_t index) const { return _configs[index]; }
+
+  // Like DiceManifest::forEach(), over the loaded results
+  size_t forEach(DiceManifest::SectionVisitor visit, void* context) const;
+
+  // Code path for load(); false (and unchanged) if the CPU lacks it.
+  // Defaults to bestIsa().
+  bool setIsa(DiceScanIsa isa);
+  DiceScanIsa getIsa() const { return _isa; }
+  static DiceScanIsa bestIsa();
+  static const char* isaName(DiceScanIsa isa);
+
+  // Smallest chunk for load() to hand to a thread (tests use tiny ones)
+  void setChunkSize(size_t bytes) { _chunkSize = bytes > 0 ? bytes : 1; }
+
+  const char* getLastError() const { return _lastError; }
+
+private:
+  DiceManifestSection* _sections;
+  DiceConfig* _configs;
+  size_t _count;
+  DiceScanIsa _isa;
+  size_t _chunkSize;
+  const char* _lastError;
+
+  bool fail(const char* error);
+
+  // Not copyable (owns its results)
+  DiceManifestScan(const DiceManifestScan&);
+  DiceManifestScan& operator=(const DiceManifestScan&);
+};
+
+#endif // DICE_CONFIG_HOST
+
+#endif // DICE_CONFIG_MANIFEST_SCAN_H
@@ -0,0 +1,141 @@
+/*
+ * DiceConfigParser - The config text format, shared by the library and
+ * the host tools in extras/tools
+ */
+
+#include "DiceConfigParser.h"
+
+DiceParseStatus DiceConfigParser::parseLine(char* line, DiceConfig& config,
+                                            char** keyOut, char** valueOut) {
+  DiceLineSpans spans = { 0, 0, 0, 0, DICE_FLOAT_EXACT };
+  DiceParseStatus status = parseLineSpan(line, strlen(line), config, spans);
+  if (status == DICE_PARSE_EMPTY || status == DICE_PARSE_NO_SEPARATOR) {
+    return status;
+  }
+  
+  // Split into key and value
+  line[spans.keyEnd] = '\0';
+  line[spans.valueEnd] = '\0';
+  if (keyOut) {
+    *keyOut = line + spans.keyStart;
+  }
+  if (valueOut) {
+    *valueOut = line + spans.valueStart;
+  }
+  
+  // Long or special values go through libc like they always have
+  if (spans.floatParse != DICE_FLOAT_EXACT) {
+    config.tumbleConstant = atof(line + spans.valueStart);
+  }
+  
+  return status;
+}
+
+// Constant-initialized, so the padding bytes are zero as well
+static const DiceConfig DEFAULT_CONFIG = DiceConfigParser::defaults();
+
+void DiceConfigParser::setDefaults(DiceConfig& config) {
+  // Copy the whole image (including padding) so images compare equal
+  memcpy(&config, &DEFAULT_CONFIG, sizeof(config));
+}
+
+static uint8_t xorBytes(uint8_t sum, const void* data, size_t len) {
+  const uint8_t* ptr = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    sum ^= ptr[i];
+  }
+  return sum;
+}
+
+uint8_t DiceConfigParser::checksum(const DiceConfig& config) {
+  uint8_t sum = 0;
+  
+  // XOR all field bytes except the checksum itself, skipping padding. The
+  // 1.x checksum XORed the raw struct up to its last byte, which took in
+  // the stored checksum and padding as well. It could only verify when the
+  // fields XORed to zero, so checksums written by 1.x don't carry over.
+  sum = xorBytes(sum, config.diceId, sizeof(config.diceId));
+  sum = xorBytes(sum, config.deviceA_mac, sizeof(config.deviceA_mac));
+  sum = xorBytes(sum, config.deviceB1_mac, sizeof(config.deviceB1_mac));
+  sum = xorBytes(sum, config.deviceB2_mac, sizeof(config.deviceB2_mac));
+  sum = xorBytes(sum, &config.x_background, sizeof(config.x_background));
+  sum = xorBytes(sum, &config.y_background, sizeof(config.y_background));
+  sum = xorBytes(sum, &config.z_background, sizeof(config.z_background));
+  sum = xorBytes(sum, &config.entang_ab1_color, sizeof(config.entang_ab1_color));
+  sum = xorBytes(sum, &config.entang_ab2_color, sizeof(config.entang_ab2_color));
+  sum = xorBytes(sum, &config.rssiLimit, sizeof(config.rssiLimit));
+  sum = xorBytes(sum, &config.isSMD, sizeof(config.isSMD));
+  sum = xorBytes(sum, &config.isNano, sizeof(config.isNano));
+  sum = xorBytes(sum, &config.alwaysSeven, sizeof(config.alwaysSeven));
+  sum = xorBytes(sum, &config.randomSwitchPoint, sizeof(config.randomSwitchPoint));
+  sum = xorBytes(sum, &config.tumbleConstant, sizeof(config.tumbleConstant));
+  sum = xorBytes(sum, &config.deepSleepTimeout, sizeof(config.deepSleepTimeout));
+  
+  return sum;
+}
+
+uint32_t DiceConfigParser::validate(const DiceConfig& config) {
+  return validateFields(config, checksum(config));
+}
+
+bool DiceConfigParser::parseMacAddress(const char* str, uint8_t* mac) {
+  return parseMac(str, str + strlen(str), mac);
+}
+
+bool DiceConfigParser::parseBool(const char* str) {
+  return parseBoolSpan(str, str + strlen(str));
+}
+
+void DiceConfigParser::trim(char* str) {
+  // Trim leading space
+  char* start = str;
+  while (isspace((unsigned char)*start)) start++;
+  
+  if (start != str) {
+    memmove(str, start, strlen(start) + 1);
+  }
+  
+  // Trim trailing space
+  char* end = str + strlen(str) - 1;
+  while (end > str && isspace((unsigned char)*end)) end--;
+  end[1] = '\0';
+}
+
+// Deliberately not constexpr, see parseConfig()
+void DiceConfigParser::errorMalformedLine() {}
+void DiceConfigParser::errorUnknownKey() {}
+void DiceConfigParser::errorBadMac() {}
+void DiceConfigParser::errorUnsupportedNumber() {}
+void DiceConfigParser::errorChecksumMismatch() {}
+void DiceConfigParser::errorInvalidValue() {}
+
+#if defined(DICE_CONFIG_CONSTEXPR_PARSE)
+
+// The compile-time parser must agree with the runtime one; these fail the
+// build of the library itself if either side drifts.
+static_assert(DiceConfigParser::parseUnsigned("0xF800", "0xF800" + 6) == 0xF800, "hex");
+static_assert(DiceConfigParser::parseUnsigned("017", "017" + 3) == 15, "octal");
+static_assert(DiceConfigParser::parseUnsigned("0x", "0x" + 2) == 0, "bare 0x");
+static_assert(DiceConfigParser::parseUnsigned(" -1", " -1" + 3) == ULONG_MAX, "negative");
+static_assert(DiceConfigParser::parseInt("-65dBm", "-65dBm" + 6) == -65, "atoi");
+static_assert(DiceConfigParser::checksumConst(DiceConfigParser::defaults()) == 0xD4, "defaults");
+
+namespace {
+constexpr DiceConfig SELF_TEST = DiceConfigParser::parseConfig(
+  "# self test\r\n"
+  "diceId = TEST1\r\n"
+  "deviceA_mac=24:6F:28:aa:bb:cc\n"
+  "rssiLimit=-65\n"
+  "isNano=TRUE\n"
+  "tumbleConstant=3.75\n"
+  "deepSleepTimeout=0x927C0\n"
+  "signature=00\n");
+}
+
+static_assert(SELF_TEST.diceId[0] == 'T' && SELF_TEST.diceId[5] == '\0', "diceId");
+static_assert(SELF_TEST.deviceA_mac[0] == 0x24 && SELF_TEST.deviceA_mac[5] == 0xCC, "mac");
+static_assert(SELF_TEST.rssiLimit == -65 && SELF_TEST.isNano && !SELF_TEST.isSMD, "fields");
+static_assert(SELF_TEST.tumbleConstant == 3.75f && SELF_TEST.deepSleepTimeout == 600000, "numbers");
+static_assert(SELF_TEST.x_background == 0xF800 && SELF_TEST.randomSwitchPoint == 50, "defaults");
+
+#endif // DICE_CONFIG_CONSTEXPR_PARSE
@@ -0,0 +1,650 @@
+/*
+ * DiceConfigParser - The config text format, shared by the library and
+ * the host tools in extras/tools so the two can never disagree about
+ * what a file means.
+ *
+ * The parse core (tokenizer, key dispatch, number and MAC parsers) is
+ * constexpr from C++14 on, so a config can also be parsed by the compiler:
+ *
+ *   constexpr DiceConfig cfg = DiceConfigParser::parseConfig(R"(
+ *     diceId=TEST1
+ *     rssiLimit=-65
+ *   )");
+ *
+ * It reproduces the strtoul(base 0) / atoi / atof / sscanf("%x") behavior
+ * the runtime parser has always had. On C++11 toolchains the same code
+ * simply runs as inline functions.
+ */
+
+#ifndef DICE_CONFIG_PARSER_H
+#define DICE_CONFIG_PARSER_H
+
+#include "DiceConfigPlatform.h"
+#include <limits.h>
+
+#if __cplusplus >= 201402L
+#define DICE_CONFIG_CONSTEXPR_PARSE 1
+#define DICE_CONSTEXPR constexpr
+#else
+#define DICE_CONSTEXPR inline
+#endif
+
+#if __cplusplus >= 202002L
+#define DICE_CONSTEVAL consteval
+#else
+#define DICE_CONSTEVAL constexpr
+#endif
+
+// Configuration structure
+struct DiceConfig {
+  char diceId[16];              // "TEST1", "BART1", etc.
+  uint8_t deviceA_mac[6];       // MAC address of device A
+  uint8_t deviceB1_mac[6];      // MAC address of device B1
+  uint8_t deviceB2_mac[6];      // MAC address of device B2
+  uint16_t x_background;        // Display background colors
+  uint16_t y_background;
+  uint16_t z_background;
+  uint16_t entang_ab1_color;
+  uint16_t entang_ab2_color;
+  int8_t rssiLimit;             // RSSI limit for entanglement detection
+  bool isSMD;                   // true for SMD, false for HDR
+  bool isNano;                  // true for NANO, false for DEVKIT
+  bool alwaysSeven;             // Force dice to always produce 7
+  uint8_t randomSwitchPoint;    // Threshold for random value (0-100)
+  float tumbleConstant;         // Number of tumbles to detect tumbling
+  uint32_t deepSleepTimeout;    // Deep sleep timeout in milliseconds
+  uint8_t checksum;             // Simple checksum for validation
+};
+
+// Outcome of parsing one line
+enum DiceParseStatus {
+  DICE_PARSE_OK,
+  DICE_PARSE_EMPTY,             // Blank line or comment
+  DICE_PARSE_NO_SEPARATOR,      // No '='
+  DICE_PARSE_BAD_MAC,           // MAC key with a malformed value (field unchanged)
+  DICE_PARSE_UNKNOWN_KEY,
+  DICE_PARSE_SIGNATURE          // "signature=" line, value left to the caller
+};
+
+// validate() result bits; 0 means valid
+enum DiceValidateError {
+  DICE_INVALID_ID            = 1 << 0,  // diceId is empty
+  DICE_INVALID_SWITCH_POINT  = 1 << 1,  // randomSwitchPoint > 100
+  DICE_INVALID_TUMBLE        = 1 << 2,  // tumbleConstant <= 0
+  DICE_INVALID_CHECKSUM      = 1 << 3   // checksum set but wrong
+};
+
+// How a float value was converted
+enum DiceFloatParse {
+  DICE_FLOAT_EXACT,             // Correctly rounded, same bits as strtod()
+  DICE_FLOAT_APPROXIMATE,       // Over 19 digits or a large exponent
+  DICE_FLOAT_UNSUPPORTED        // Hex float, inf or nan
+};
+
+// Where key and value sit in a parsed line (offsets, end exclusive)
+struct DiceLineSpans {
+  size_t keyStart;
+  size_t keyEnd;
+  size_t valueStart;
+  size_t valueEnd;
+  DiceFloatParse floatParse;
+};
+
+class DiceConfigParser {
+public:
+  // Parse one line (without '\n'; a trailing '\r' is fine) into config.
+  // Key and value are NUL-terminated in place; key/value (optional)
+  // point at them afterwards.
+  static DiceParseStatus parseLine(char* line, DiceConfig& config,
+                                   char** key = nullptr, char** value = nullptr);
+
+  // Library defaults
+  static void setDefaults(DiceConfig& config);
+  static constexpr DiceConfig defaults();
+
+  // XOR of all field bytes except the checksum (padding excluded)
+  static uint8_t checksum(const DiceConfig& config);
+
+  // Field rules used by validate(); returns DiceValidateError bits
+  static uint32_t validate(const DiceConfig& config);
+  static DICE_CONSTEXPR uint32_t validateFields(const DiceConfig& config, uint8_t expectedChecksum);
+
+  static bool parseMacAddress(const char* str, uint8_t* mac);
+  static bool parseBool(const char* str);
+  static void trim(char* str);
+
+  // Parse core. Work on [begin, end) without modifying the text.
+  static DICE_CONSTEXPR DiceParseStatus parseLineSpan(const char* line, size_t len,
+                                                      DiceConfig& config, DiceLineSpans& spans);
+  static DICE_CONSTEXPR unsigned long parseUnsigned(const char* begin, const char* end);
+  static DICE_CONSTEXPR int parseInt(const char* begin, const char* end);
+  static DICE_CONSTEXPR DiceFloatParse parseFloat(const char* begin, const char* end, double& out);
+  static DICE_CONSTEXPR bool parseMac(const char* begin, const char* end, uint8_t* mac);
+  static DICE_CONSTEXPR bool parseBoolSpan(const char* begin, const char* end);
+
+#if defined(DICE_CONFIG_CONSTEXPR_PARSE)
+  // Whole config text, same line framing as load(), starting from the
+  // defaults. Stricter than load(): malformed lines, unknown keys, bad
+  // MACs, a wrong checksum or invalid values are compile errors (the
+  // compiler reports a call to one of the error*() functions below).
+  static DICE_CONSTEVAL DiceConfig parseConfig(const char* text);
+
+  // Checksum computed arithmetically (no byte access), little-endian
+  static constexpr uint8_t checksumConst(const DiceConfig& config);
+#endif
+
+  // Never constexpr: reaching one during constant evaluation is the error
+  static void errorMalformedLine();
+  static void errorUnknownKey();
+  static void errorBadMac();
+  static void errorUnsupportedNumber();
+  static void errorChecksumMismatch();
+  static void errorInvalidValue();
+
+private:
+  static DICE_CONSTEXPR bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+  }
+  static DICE_CONSTEXPR int digitValue(char c) {
+    return (c >= '0' && c <= '9') ? c - '0' :
+           (c >= 'a' && c <= 'z') ? c - 'a' + 10 :
+           (c >= 'A' && c <= 'Z') ? c - 'A' + 10 : 99;
+  }
+  static DICE_CONSTEXPR char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+  }
+  static DICE_CONSTEXPR bool spanEquals(const char* begin, const char* end, const char* str);
+  static DICE_CONSTEXPR bool spanEqualsNoCase(const char* begin, const char* end, const char* str);
+  static DICE_CONSTEXPR double powerOfTen(int exponent);
+#if defined(DICE_CONFIG_CONSTEXPR_PARSE)
+  static constexpr uint32_t floatBits(float value);
+  static constexpr uint8_t xorWord(uint8_t sum, uint32_t value, int bytes);
+#endif
+};
+
+// ============================================================================
+// Parse core
+// ============================================================================
+
+constexpr DiceConfig DiceConfigParser::defaults() {
+  return DiceConfig{
+    "DEFAULT",
+    { 0, 0, 0, 0, 0, 0 },       // MAC addresses (all zeros)
+    { 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0 },
+    0xF800,                     // x_background: red (RGB565)
+    0x07E0,                     // y_background: green
+    0x001F,                     // z_background: blue
+    0xFFFF,                     // entang_ab1_color: white
+    0x0000,                     // entang_ab2_color: black
+    -70,                        // rssiLimit
+    false, false, false,        // isSMD, isNano, alwaysSeven
+    50,                         // randomSwitchPoint
+    2.5f,                       // tumbleConstant
+    300000,                     // deepSleepTimeout: 5 minutes
+    0                           // checksum (calculated on save)
+  };
+}
+
+DICE_CONSTEXPR uint32_t DiceConfigParser::validateFields(const DiceConfig& config,
+                                                         uint8_t expectedChecksum) {
+  return (config.diceId[0] == '\0' ? (uint32_t)DICE_INVALID_ID : 0) |
+         (config.randomSwitchPoint > 100 ? (uint32_t)DICE_INVALID_SWITCH_POINT : 0) |
+         (config.tumbleConstant <= 0 ? (uint32_t)DICE_INVALID_TUMBLE : 0) |
+         (config.checksum != 0 && config.checksum != expectedChecksum ?
+            (uint32_t)DICE_INVALID_CHECKSUM : 0);
+}
+
+DICE_CONSTEXPR bool DiceConfigParser::spanEquals(const char* begin, const char* end, const char* str) {
+  while (begin < end && *str != '\0' && *begin == *str) {
+    begin++;
+    str++;
+  }
+  return begin == end && *str == '\0';
+}
+
+DICE_CONSTEXPR bool DiceConfigParser::spanEqualsNoCase(const char* begin, const char* end, const char* str) {
+  while (begin < end && *str != '\0' && lower(*begin) == lower(*str)) {
+    begin++;
+    str++;
+  }
+  return begin == end && *str == '\0';
+}
+
+// strtoul(str, NULL, 0): whitespace, sign, 0x/0 prefix, ULONG_MAX on overflow
+DICE_CONSTEXPR unsigned long DiceConfigParser::parseUnsigned(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) p++;
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  unsigned long base = 10;
+  if (p < end && *p == '0') {
+    if (p + 2 < end && (p[1] == 'x' || p[1] == 'X') && digitValue(p[2]) < 16) {
+      base = 16;
+      p += 2;
+    } else {
+      base = 8;
+    }
+  }
+
+  unsigned long value = 0;
+  bool overflow = false;
+  for (; p < end && (unsigned long)digitValue(*p) < base; p++) {
+    unsigned long digit = (unsigned long)digitValue(*p);
+    if (value > (ULONG_MAX - digit) / base) {
+      overflow = true;
+    } else {
+      value = value * base + digit;
+    }
+  }
+
+  if (overflow) {
+    return ULONG_MAX;
+  }
+  return negative ? 0UL - value : value;
+}
+
+// atoi(): strtol(str, NULL, 10) clamped to long, then narrowed to int
+DICE_CONSTEXPR int DiceConfigParser::parseInt(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) p++;
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  unsigned long limit = negative ? (unsigned long)LONG_MAX + 1UL : (unsigned long)LONG_MAX;
+  unsigned long magnitude = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    unsigned long digit = (unsigned long)(*p - '0');
+    if (magnitude > (limit - digit) / 10) {
+      magnitude = limit;
+    } else {
+      magnitude = magnitude * 10 + digit;
+    }
+  }
+
+  long value = negative ? (magnitude == limit ? LONG_MIN : -(long)magnitude) : (long)magnitude;
+  return (int)value;
+}
+
+DICE_CONSTEXPR double DiceConfigParser::powerOfTen(int exponent) {
+  double value = 1.0;
+  for (int i = 0; i < exponent; i++) {
+    value *= 10.0;
+  }
+  return value;
+}
+
+// strtod() for decimal input. Up to 19 significant digits and 10^±22 the
+// result is one correctly rounded IEEE operation, so it matches libc bit
+// for bit; beyond that it is reported as approximate.
+DICE_CONSTEXPR DiceFloatParse DiceConfigParser::parseFloat(const char* p, const char* end, double& out) {
+  out = 0.0;
+  while (p < end && isSpace(*p)) p++;
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  // Forms strtod() accepts but this parser doesn't reproduce
+  if (p < end && (lower(*p) == 'i' || lower(*p) == 'n')) {
+    return DICE_FLOAT_UNSUPPORTED;
+  }
+  if (p + 1 < end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    return DICE_FLOAT_UNSUPPORTED;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  bool dropped = false;
+
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    any = true;
+    if (mantissa == 0 && *p == '0') {
+      continue;
+    }
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+      digits++;
+    } else {
+      exponent++;
+      dropped = dropped || *p != '0';
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      any = true;
+      if (mantissa == 0 && *p == '0') {
+        exponent--;
+      } else if (digits < 19) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        digits++;
+        exponent--;
+      } else {
+        dropped = dropped || *p != '0';
+      }
+    }
+  }
+  if (!any) {
+    return DICE_FLOAT_EXACT;
+  }
+
+  // Exponent only counts if at least one digit follows the 'e'
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool expNegative = false;
+    if (q < end && (*q == '+' || *q == '-')) {
+      expNegative = *q == '-';
+      q++;
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      int value = 0;
+      for (; q < end && *q >= '0' && *q <= '9'; q++) {
+        if (value < 100000) {
+          value = value * 10 + (*q - '0');
+        }
+      }
+      exponent += expNegative ? -value : value;
+    }
+  }
+
+  if (mantissa == 0) {
+    out = negative ? -0.0 : 0.0;
+    return DICE_FLOAT_EXACT;
+  }
+
+  double value = (double)mantissa;
+  if (!dropped && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+    value = exponent >= 0 ? value * powerOfTen(exponent) : value / powerOfTen(-exponent);
+    out = negative ? -value : value;
+    return DICE_FLOAT_EXACT;
+  }
+
+  if (exponent > 308 - digits) {
+    return DICE_FLOAT_UNSUPPORTED;  // Would overflow to inf
+  }
+  for (; exponent > 0; exponent--) value *= 10.0;
+  for (; exponent < 0 && value != 0.0; exponent++) value /= 10.0;
+  out = negative ? -value : value;
+  return DICE_FLOAT_APPROXIMATE;
+}
+
+// sscanf(str, "%x:%x:%x:%x:%x:%x") == 6
+DICE_CONSTEXPR bool DiceConfigParser::parseMac(const char* p, const char* end, uint8_t* mac) {
+  unsigned long values[6] = { 0, 0, 0, 0, 0, 0 };
+
+  for (int i = 0; i < 6; i++) {
+    if (i > 0) {
+      if (p >= end || *p != ':') {
+        return false;
+      }
+      p++;
+    }
+
+    while (p < end && isSpace(*p)) p++;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+      negative = *p == '-';
+      p++;
+    }
+    // Unlike strtoul(), scanf() takes a bare "0x" as zero
+    if (p + 1 < end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+      p += 2;
+    } else if (p >= end || digitValue(*p) >= 16) {
+      return false;
+    }
+
+    unsigned long value = 0;
+    bool overflow = false;
+    for (; p < end && digitValue(*p) < 16; p++) {
+      unsigned long digit = (unsigned long)digitValue(*p);
+      if (value > (ULONG_MAX - digit) / 16) {
+        overflow = true;
+      } else {
+        value = value * 16 + digit;
+      }
+    }
+    values[i] = overflow ? ULONG_MAX : (negative ? 0UL - value : value);
+  }
+
+  for (int i = 0; i < 6; i++) {
+    mac[i] = (uint8_t)values[i];
+  }
+  return true;
+}
+
+// strcasecmp(str, "true") == 0 || strcmp(str, "1") == 0
+DICE_CONSTEXPR bool DiceConfigParser::parseBoolSpan(const char* begin, const char* end) {
+  return spanEqualsNoCase(begin, end, "true") || spanEquals(begin, end, "1");
+}
+
+DICE_CONSTEXPR DiceParseStatus DiceConfigParser::parseLineSpan(const char* line, size_t len,
+                                                               DiceConfig& config,
+                                                               DiceLineSpans& spans) {
+  spans.keyStart = spans.keyEnd = spans.valueStart = spans.valueEnd = 0;
+  spans.floatParse = DICE_FLOAT_EXACT;
+
+  // Runtime lines are C strings: stop at an embedded NUL
+  size_t n = 0;
+  while (n < len && line[n] != '\0') n++;
+
+  // Remove carriage return if present, then trim
+  if (n > 0 && line[n - 1] == '\r') n--;
+  size_t start = 0;
+  while (start < n && isSpace(line[start])) start++;
+  while (n > start && isSpace(line[n - 1])) n--;
+
+  // Skip empty lines and comments
+  if (start == n || line[start] == '#') {
+    return DICE_PARSE_EMPTY;
+  }
+
+  // Find the '=' separator
+  size_t separator = start;
+  while (separator < n && line[separator] != '=') separator++;
+  if (separator == n) {
+    return DICE_PARSE_NO_SEPARATOR;
+  }
+
+  // Split into key and value, trimming both
+  spans.keyStart = start;
+  spans.keyEnd = separator;
+  while (spans.keyEnd > spans.keyStart && isSpace(line[spans.keyEnd - 1])) spans.keyEnd--;
+  spans.valueStart = separator + 1;
+  spans.valueEnd = n;
+  while (spans.valueStart < n && isSpace(line[spans.valueStart])) spans.valueStart++;
+
+  const char* key = line + spans.keyStart;
+  const char* keyEnd = line + spans.keyEnd;
+  const char* value = line + spans.valueStart;
+  const char* valueEnd = line + spans.valueEnd;
+
+  // Parse based on key
+  if (spanEquals(key, keyEnd, "diceId")) {
+    // strncpy(): copy up to 15 chars and zero-fill the rest
+    size_t i = 0;
+    for (; i < sizeof(config.diceId) - 1 && value + i < valueEnd; i++) {
+      config.diceId[i] = value[i];
+    }
+    for (; i < sizeof(config.diceId); i++) {
+      config.diceId[i] = '\0';
+    }
+  }
+  else if (spanEquals(key, keyEnd, "deviceA_mac")) {
+    if (!parseMac(value, valueEnd, config.deviceA_mac)) {
+      return DICE_PARSE_BAD_MAC;
+    }
+  }
+  else if (spanEquals(key, keyEnd, "deviceB1_mac")) {
+    if (!parseMac(value, valueEnd, config.deviceB1_mac)) {
+      return DICE_PARSE_BAD_MAC;
+    }
+  }
+  else if (spanEquals(key, keyEnd, "deviceB2_mac")) {
+    if (!parseMac(value, valueEnd, config.deviceB2_mac)) {
+      return DICE_PARSE_BAD_MAC;
+    }
+  }
+  else if (spanEquals(key, keyEnd, "x_background")) {
+    config.x_background = (uint16_t)parseUnsigned(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "y_background")) {
+    config.y_background = (uint16_t)parseUnsigned(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "z_background")) {
+    config.z_background = (uint16_t)parseUnsigned(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "entang_ab1_color")) {
+    config.entang_ab1_color = (uint16_t)parseUnsigned(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "entang_ab2_color")) {
+    config.entang_ab2_color = (uint16_t)parseUnsigned(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "rssiLimit")) {
+    config.rssiLimit = (int8_t)parseInt(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "isSMD")) {
+    config.isSMD = parseBoolSpan(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "isNano")) {
+    config.isNano = parseBoolSpan(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "alwaysSeven")) {
+    config.alwaysSeven = parseBoolSpan(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "randomSwitchPoint")) {
+    config.randomSwitchPoint = (uint8_t)parseInt(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "tumbleConstant")) {
+    double parsed = 0.0;
+    spans.floatParse = parseFloat(value, valueEnd, parsed);
+    config.tumbleConstant = (float)parsed;
+  }
+  else if (spanEquals(key, keyEnd, "deepSleepTimeout")) {
+    config.deepSleepTimeout = (uint32_t)parseUnsigned(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "checksum")) {
+    config.checksum = (uint8_t)parseInt(value, valueEnd);
+  }
+  else if (spanEquals(key, keyEnd, "signature")) {
+    return DICE_PARSE_SIGNATURE;
+  }
+  else {
+    return DICE_PARSE_UNKNOWN_KEY;
+  }
+
+  return DICE_PARSE_OK;
+}
+
+#if defined(DICE_CONFIG_CONSTEXPR_PARSE)
+
+// IEEE-754 single bits from arithmetic alone (-0 as +0, one nan)
+constexpr uint32_t DiceConfigParser::floatBits(float value) {
+  if (value == 0.0f) {
+    return 0;
+  }
+  if (value != value) {
+    return 0x7FC00000UL;            // nan
+  }
+  if (value - value != 0.0f) {
+    return value < 0.0f ? 0xFF800000UL : 0x7F800000UL;  // inf
+  }
+  uint32_t sign = value < 0.0f ? 0x80000000UL : 0;
+  double x = value < 0.0f ? -(double)value : (double)value;
+  int exponent = 0;
+  while (x >= 2.0) { x /= 2.0; exponent++; }
+  while (x < 1.0) { x *= 2.0; exponent--; }
+
+  if (exponent < -126) {
+    for (; exponent < -126; exponent++) x /= 2.0;
+    return sign | (uint32_t)(x * 8388608.0);
+  }
+  return sign | ((uint32_t)(exponent + 127) << 23) | (uint32_t)((x - 1.0) * 8388608.0);
+}
+
+constexpr uint8_t DiceConfigParser::xorWord(uint8_t sum, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    sum ^= (uint8_t)(value >> (8 * i));
+  }
+  return sum;
+}
+
+constexpr uint8_t DiceConfigParser::checksumConst(const DiceConfig& config) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i < sizeof(config.diceId); i++) sum ^= (uint8_t)config.diceId[i];
+  for (int i = 0; i < 6; i++) sum ^= config.deviceA_mac[i];
+  for (int i = 0; i < 6; i++) sum ^= config.deviceB1_mac[i];
+  for (int i = 0; i < 6; i++) sum ^= config.deviceB2_mac[i];
+  sum = xorWord(sum, config.x_background, 2);
+  sum = xorWord(sum, config.y_background, 2);
+  sum = xorWord(sum, config.z_background, 2);
+  sum = xorWord(sum, config.entang_ab1_color, 2);
+  sum = xorWord(sum, config.entang_ab2_color, 2);
+  sum = xorWord(sum, (uint8_t)config.rssiLimit, 1);
+  sum = xorWord(sum, config.isSMD, 1);
+  sum = xorWord(sum, config.isNano, 1);
+  sum = xorWord(sum, config.alwaysSeven, 1);
+  sum = xorWord(sum, config.randomSwitchPoint, 1);
+  sum = xorWord(sum, floatBits(config.tumbleConstant), 4);
+  sum = xorWord(sum, config.deepSleepTimeout, 4);
+  return sum;
+}
+
+DICE_CONSTEVAL DiceConfig DiceConfigParser::parseConfig(const char* text) {
+  DiceConfig config = defaults();
+  size_t pos = 0;
+
+  // Same framing as DiceLineReader with a 128-byte line buffer
+  while (text[pos] != '\0') {
+    size_t start = pos;
+    size_t len = 0;
+    while (len < 127 && text[pos] != '\0' && text[pos] != '\n') {
+      pos++;
+      len++;
+    }
+    if (len < 127 && text[pos] == '\n') {
+      pos++;
+    }
+
+    DiceLineSpans spans = { 0, 0, 0, 0, DICE_FLOAT_EXACT };
+    switch (parseLineSpan(text + start, len, config, spans)) {
+      case DICE_PARSE_NO_SEPARATOR:
+        errorMalformedLine();
+        break;
+      case DICE_PARSE_UNKNOWN_KEY:
+        errorUnknownKey();
+        break;
+      case DICE_PARSE_BAD_MAC:
+        errorBadMac();
+        break;
+      default:
+        break;
+    }
+    if (spans.floatParse == DICE_FLOAT_UNSUPPORTED) {
+      errorUnsupportedNumber();
+    }
+  }
+
+  uint32_t errors = validateFields(config, checksumConst(config));
+  if (errors & DICE_INVALID_CHECKSUM) {
+    errorChecksumMismatch();
+  }
+  if (errors != 0) {
+    errorInvalidValue();
+  }
+  return config;
+}
+
+#endif // DICE_CONFIG_CONSTEXPR_PARSE
+
+#endif // DICE_CONFIG_PARSER_H
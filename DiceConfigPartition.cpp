@@ -0,0 +1,293 @@
+/*
+ * DiceConfigPartition - Binary DiceConfig records in a raw data partition
+ */
+
+#include "DiceConfigPartition.h"
+#include "DiceConfigRtc.h"
+
+#if !defined(ESP_PLATFORM)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const uint32_t RECORD_MAGIC = 0x44435031; // "DCP1"
+
+DiceConfigPartition::DiceConfigPartition()
+  : _map(nullptr), _size(0), _slotCount(0), _current(-1), _next(0),
+    _sequence(0), _lastError(""),
+#if defined(ESP_PLATFORM)
+    _partition(nullptr), _mapHandle(0)
+#else
+    _fd(-1)
+#endif
+{
+}
+
+DiceConfigPartition::~DiceConfigPartition() {
+  end();
+}
+
+bool DiceConfigPartition::begin(const char* label) {
+  end();
+
+#if defined(ESP_PLATFORM)
+  _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                        (esp_partition_subtype_t)DICE_CONFIG_PARTITION_SUBTYPE,
+                                        label);
+  if (_partition == nullptr) {
+    return fail("Config partition not found");
+  }
+  _size = _partition->size;
+  if (_size < 2 * DICE_CONFIG_PARTITION_SECTOR) {
+    _partition = nullptr;
+    return fail("Config partition needs at least two sectors");
+  }
+  const void* map = nullptr;
+  if (esp_partition_mmap(_partition, 0, _size, ESP_PARTITION_MMAP_DATA,
+                         &map, &_mapHandle) != ESP_OK) {
+    _partition = nullptr;
+    return fail("Config partition mmap failed");
+  }
+  _map = (const uint8_t*)map;
+#else
+  _fd = open(label, O_RDWR | O_CREAT, 0644);
+  if (_fd < 0) {
+    return fail("Config partition file open failed");
+  }
+
+  struct stat st;
+  if (fstat(_fd, &st) != 0) {
+    end();
+    return fail("Config partition file stat failed");
+  }
+
+  // New file: fill with 0xFF like freshly erased flash
+  if (st.st_size == 0) {
+    uint8_t erased[DICE_CONFIG_PARTITION_SECTOR];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t offset = 0; offset < DICE_CONFIG_PARTITION_HOST_SIZE; offset += sizeof(erased)) {
+      if (pwrite(_fd, erased, sizeof(erased), offset) != (ssize_t)sizeof(erased)) {
+        end();
+        return fail("Config partition file write failed");
+      }
+    }
+    st.st_size = DICE_CONFIG_PARTITION_HOST_SIZE;
+  }
+
+  _size = (size_t)st.st_size & ~(size_t)(DICE_CONFIG_PARTITION_SECTOR - 1);
+  if (_size < 2 * DICE_CONFIG_PARTITION_SECTOR) {
+    end();
+    return fail("Config partition needs at least two sectors");
+  }
+
+  // Writes go through pwrite(), the mapping only reads (like flash)
+  void* map = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+  if (map == MAP_FAILED) {
+    end();
+    return fail("Config partition mmap failed");
+  }
+  _map = (const uint8_t*)map;
+#endif
+
+  _slotCount = (_size / DICE_CONFIG_PARTITION_SECTOR) * RECORDS_PER_SECTOR;
+  scan();
+  return true;
+}
+
+void DiceConfigPartition::end() {
+#if defined(ESP_PLATFORM)
+  if (_map != nullptr) {
+    esp_partition_munmap(_mapHandle);
+  }
+  _partition = nullptr;
+#else
+  if (_map != nullptr) {
+    munmap((void*)_map, _size);
+  }
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+#endif
+  _map = nullptr;
+  _size = 0;
+  _slotCount = 0;
+  _current = -1;
+  _next = 0;
+  _sequence = 0;
+}
+
+bool DiceConfigPartition::isOpen() const {
+  return _map != nullptr;
+}
+
+const DiceConfig* DiceConfigPartition::config() const {
+  if (_current < 0) {
+    return nullptr;
+  }
+  return &slot((size_t)_current)->config;
+}
+
+bool DiceConfigPartition::write(const DiceConfig& config) {
+  if (_map == nullptr) {
+    return fail("Config partition not open");
+  }
+
+  size_t index = _next;
+
+  // Leftovers of an interrupted write: continue in the next sector
+  if (index % RECORDS_PER_SECTOR != 0 && !isBlank(index)) {
+    index = (index / RECORDS_PER_SECTOR + 1) * RECORDS_PER_SECTOR % _slotCount;
+  }
+
+  // Entering a sector: erase it first. It holds the oldest records; the
+  // newest one is always in the sector before.
+  if (index % RECORDS_PER_SECTOR == 0) {
+    size_t sector = index / RECORDS_PER_SECTOR;
+    for (size_t i = index; i < index + RECORDS_PER_SECTOR; i++) {
+      if (!isBlank(i)) {
+        if (!eraseSector(sector)) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+
+  // Build the record zeroed so the padding is deterministic
+  Record record;
+  memset(&record, 0, sizeof(record));
+  record.magic = RECORD_MAGIC;
+  record.layout = sizeof(DiceConfig);
+  record.sequence = _sequence + 1;
+  record.config = config;
+  record.crc = DiceConfigRtc::crc32(0, &record, offsetof(Record, crc));
+
+  if (!program(slotOffset(index), &record, sizeof(record))) {
+    _next = (index + 1) % _slotCount;
+    return false;
+  }
+
+  // Read back through the mapping
+  if (!isValid(slot(index)) || slot(index)->sequence != record.sequence) {
+    _next = (index + 1) % _slotCount;
+    return fail("Config partition verify failed");
+  }
+
+  _current = (long)index;
+  _next = (index + 1) % _slotCount;
+  _sequence = record.sequence;
+  return true;
+}
+
+bool DiceConfigPartition::erase() {
+  if (_map == nullptr) {
+    return fail("Config partition not open");
+  }
+  for (size_t sector = 0; sector < _size / DICE_CONFIG_PARTITION_SECTOR; sector++) {
+    if (!eraseSector(sector)) {
+      return false;
+    }
+  }
+  _current = -1;
+  _next = 0;
+  return true;
+}
+
+uint32_t DiceConfigPartition::getSequence() const {
+  return _sequence;
+}
+
+size_t DiceConfigPartition::getCapacity() const {
+  return _slotCount;
+}
+
+size_t DiceConfigPartition::getSize() const {
+  return _size;
+}
+
+const char* DiceConfigPartition::getLastError() const {
+  return _lastError;
+}
+
+// Find the newest valid record; the next write goes right after it
+void DiceConfigPartition::scan() {
+  _current = -1;
+  _sequence = 0;
+  for (size_t i = 0; i < _slotCount; i++) {
+    const Record* record = slot(i);
+    if (isValid(record) && (_current < 0 || record->sequence > _sequence)) {
+      _current = (long)i;
+      _sequence = record->sequence;
+    }
+  }
+  _next = _current < 0 ? 0 : ((size_t)_current + 1) % _slotCount;
+}
+
+const DiceConfigPartition::Record* DiceConfigPartition::slot(size_t index) const {
+  return (const Record*)(_map + slotOffset(index));
+}
+
+bool DiceConfigPartition::isValid(const Record* record) const {
+  return record->magic == RECORD_MAGIC &&
+         record->layout == sizeof(DiceConfig) &&
+         record->crc == DiceConfigRtc::crc32(0, record, offsetof(Record, crc));
+}
+
+bool DiceConfigPartition::isBlank(size_t index) const {
+  const uint8_t* ptr = _map + slotOffset(index);
+  for (size_t i = 0; i < RECORD_SIZE; i++) {
+    if (ptr[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t DiceConfigPartition::slotOffset(size_t index) const {
+  return (index / RECORDS_PER_SECTOR) * DICE_CONFIG_PARTITION_SECTOR +
+         (index % RECORDS_PER_SECTOR) * RECORD_SIZE;
+}
+
+bool DiceConfigPartition::eraseSector(size_t sector) {
+#if defined(ESP_PLATFORM)
+  if (esp_partition_erase_range(_partition, sector * DICE_CONFIG_PARTITION_SECTOR,
+                                DICE_CONFIG_PARTITION_SECTOR) != ESP_OK) {
+    return fail("Config partition erase failed");
+  }
+#else
+  uint8_t erased[DICE_CONFIG_PARTITION_SECTOR];
+  memset(erased, 0xFF, sizeof(erased));
+  if (pwrite(_fd, erased, sizeof(erased), sector * DICE_CONFIG_PARTITION_SECTOR) !=
+      (ssize_t)sizeof(erased)) {
+    return fail("Config partition erase failed");
+  }
+#endif
+  return true;
+}
+
+bool DiceConfigPartition::program(size_t offset, const void* data, size_t len) {
+#if defined(ESP_PLATFORM)
+  if (esp_partition_write(_partition, offset, data, len) != ESP_OK) {
+    return fail("Config partition write failed");
+  }
+#else
+  // NOR flash can only clear bits
+  uint8_t buffer[sizeof(Record)];
+  const uint8_t* src = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    buffer[i] = src[i] & _map[offset + i];
+  }
+  if (pwrite(_fd, buffer, len, offset) != (ssize_t)len) {
+    return fail("Config partition write failed");
+  }
+#endif
+  return true;
+}
+
+bool DiceConfigPartition::fail(const char* error) {
+  _lastError = error;
+  return false;
+}
@@ -0,0 +1,106 @@
+/*
+ * DiceConfigPartition - Binary DiceConfig records in a raw data partition
+ * The partition is memory-mapped, so the current config is read in place
+ * from flash with no filesystem, no parsing and no copy. Saves append a
+ * new record; sectors are erased only when the log wraps around to them,
+ * which spreads wear over the whole partition.
+ *
+ * On ESP32 this uses esp_partition_mmap(). On host a file of the same
+ * size (filled with 0xFF like erased flash) is mapped instead.
+ *
+ * partitions.csv:
+ *   diceconfig, data, 0x40, , 0x2000,
+ */
+
+#ifndef DICE_CONFIG_PARTITION_H
+#define DICE_CONFIG_PARTITION_H
+
+#include "DiceConfigPlatform.h"
+#include "DiceConfigParser.h"
+
+#if defined(ESP_PLATFORM)
+#include <esp_partition.h>
+#endif
+
+#ifndef DICE_CONFIG_PARTITION_LABEL
+#define DICE_CONFIG_PARTITION_LABEL "diceconfig"
+#endif
+
+// Data subtype in partitions.csv; 0x40-0xFE are free for applications
+#ifndef DICE_CONFIG_PARTITION_SUBTYPE
+#define DICE_CONFIG_PARTITION_SUBTYPE 0x40
+#endif
+
+// Host stand-in: file size (two erase sectors by default)
+#ifndef DICE_CONFIG_PARTITION_HOST_SIZE
+#define DICE_CONFIG_PARTITION_HOST_SIZE 0x2000
+#endif
+
+#define DICE_CONFIG_PARTITION_SECTOR 4096
+
+class DiceConfigPartition {
+public:
+  DiceConfigPartition();
+  ~DiceConfigPartition();
+
+  // Find and map the partition and locate the newest record. On host,
+  // label is a file path; the file is created if it doesn't exist.
+  // Needs at least two sectors so erasing never hits the newest record.
+  bool begin(const char* label = DICE_CONFIG_PARTITION_LABEL);
+  void end();
+  bool isOpen() const;
+
+  // Newest valid record, pointing into the mapping. Stays valid until
+  // the next write(), erase() or end(). nullptr if there is none.
+  const DiceConfig* config() const;
+
+  // Append a record with the next sequence number
+  bool write(const DiceConfig& config);
+
+  // Erase the whole partition
+  bool erase();
+
+  uint32_t getSequence() const;
+  size_t getCapacity() const;      // Records per pass over the partition
+  size_t getSize() const;
+  const char* getLastError() const;
+
+private:
+  // One record; a torn write fails the CRC and is skipped
+  struct Record {
+    uint32_t magic;
+    uint32_t layout;               // sizeof(DiceConfig)
+    uint32_t sequence;
+    DiceConfig config;
+    uint32_t crc;                  // Over everything above
+  };
+
+  // Records never straddle a sector
+  static const size_t RECORD_SIZE = (sizeof(Record) + 15) & ~(size_t)15;
+  static const size_t RECORDS_PER_SECTOR = DICE_CONFIG_PARTITION_SECTOR / RECORD_SIZE;
+
+  const uint8_t* _map;
+  size_t _size;
+  size_t _slotCount;
+  long _current;                   // Slot of the newest record, -1 if none
+  size_t _next;                    // Slot the next write goes to
+  uint32_t _sequence;
+  const char* _lastError;
+#if defined(ESP_PLATFORM)
+  const esp_partition_t* _partition;
+  esp_partition_mmap_handle_t _mapHandle;
+#else
+  int _fd;
+#endif
+
+  void scan();
+  const Record* slot(size_t index) const;
+  bool isValid(const Record* record) const;
+  bool isBlank(size_t index) const;
+  size_t slotOffset(size_t index) const;
+  bool eraseSector(size_t sector);
+  bool program(size_t offset, const void* data, size_t len);
+  bool fail(const char* error);
+};
+
+#endif // DICE_CONFIG_PARTITION_H
@@ -0,0 +1,291 @@
+/*
+ * DiceConfigPattern - Filename patterns for config file discovery
+ */
+
+#include "DiceConfigPattern.h"
+
+DicePatternSet::DicePatternSet() : _count(0), _maxDepth(0), _hash(0) {
+  _text[0] = '\0';
+  compile(DICE_CONFIG_PATTERNS);
+}
+
+bool DicePatternSet::compile(const char* patterns) {
+  _count = 0;
+  _maxDepth = 0;
+  _hash = 2166136261UL;
+
+  size_t used = 0;
+  const char* p = patterns;
+  while (*p != '\0') {
+    // One pattern, up to ';'
+    const char* end = p;
+    while (*end != '\0' && *end != ';') end++;
+    while (p < end && *p == ' ') p++;
+
+    if (p < end) {
+      if (_count == DICE_CONFIG_PATTERN_MAX) {
+        _count = 0;
+        return false;
+      }
+      Pattern& pattern = _patterns[_count];
+      pattern.offset = (uint8_t)used;
+      pattern.depth = 0;
+
+      // Copy normalized: no leading '/', no empty components
+      bool lastSlash = true;
+      for (const char* c = p; c < end; c++) {
+        if (*c == '/' && lastSlash) {
+          continue;
+        }
+        if (used + 2 > sizeof(_text) || used + 2 > 255) {
+          _count = 0;
+          return false;
+        }
+        lastSlash = *c == '/';
+        _text[used++] = *c;
+      }
+      while (used > pattern.offset && (_text[used - 1] == '/' || _text[used - 1] == ' ')) {
+        used--;
+      }
+      pattern.length = (uint8_t)(used - pattern.offset);
+      _text[used++] = '\0';
+
+      if (pattern.length > 0) {
+        // Depth and the literal tail after the last wildcard or '/'
+        const char* text = _text + pattern.offset;
+        const char* textEnd = text + pattern.length;
+        for (const char* c = text; c < textEnd; c = componentEnd(c, textEnd) + 1) {
+          const char* compEnd = componentEnd(c, textEnd);
+          if (isGlobstar(c, compEnd)) {
+            pattern.depth = ANY_DEPTH;
+          } else if (compEnd < textEnd && pattern.depth != ANY_DEPTH) {
+            pattern.depth++;
+          }
+          if (compEnd == textEnd) {
+            break;
+          }
+        }
+        uint8_t tail = 0;
+        while (tail < pattern.length) {
+          char c = textEnd[-1 - (int)tail];
+          if (c == '*' || c == '?' || c == '/') break;
+          tail++;
+        }
+        pattern.tailLength = tail;
+
+        if (pattern.depth > _maxDepth) {
+          _maxDepth = pattern.depth;
+        }
+        for (size_t i = 0; i <= pattern.length; i++) {
+          _hash = (_hash ^ (uint8_t)text[i]) * 16777619UL;
+        }
+        _count++;
+      } else {
+        used = pattern.offset;
+      }
+    }
+
+    p = *end == ';' ? end + 1 : end;
+  }
+
+  return _count > 0;
+}
+
+const char* DicePatternSet::pattern(size_t index) const {
+  return index < _count ? _text + _patterns[index].offset : "";
+}
+
+int DicePatternSet::match(const char* path) const {
+  while (*path == '/') path++;
+
+  size_t length = strlen(path);
+  uint8_t depth = 0;
+  for (const char* c = path; *c != '\0'; c++) {
+    if (*c == '/' && depth < ANY_DEPTH - 1) depth++;
+  }
+
+  for (uint8_t i = 0; i < _count; i++) {
+    if (matchPattern(_patterns[i], path, length, depth)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool DicePatternSet::matchPattern(const Pattern& pattern, const char* path, size_t pathLength,
+                                  uint8_t pathDepth) const {
+  const char* p = _text + pattern.offset;
+  const char* pEnd = p + pattern.length;
+  const char* s = path;
+  const char* sEnd = path + pathLength;
+
+  // Cheap rejects first: component count and literal suffix
+  if (pattern.depth != ANY_DEPTH && pattern.depth != pathDepth) {
+    return false;
+  }
+  if (pathLength < pattern.tailLength ||
+      memcmp(sEnd - pattern.tailLength, pEnd - pattern.tailLength, pattern.tailLength) != 0) {
+    return false;
+  }
+
+  // Component-wise wildcard match; "**" backtracks like '*' does within
+  // a component, so this needs no recursion
+  const char* starP = nullptr;
+  const char* starS = nullptr;
+  while (s < sEnd) {
+    const char* pc = pEnd;
+    if (p < pEnd) {
+      pc = componentEnd(p, pEnd);
+      if (isGlobstar(p, pc)) {
+        starP = pc < pEnd ? pc + 1 : pEnd;
+        starS = s;
+        p = starP;
+        continue;
+      }
+    }
+
+    const char* sc = componentEnd(s, sEnd);
+    if (p < pEnd && matchSegment(p, pc, s, sc)) {
+      p = pc < pEnd ? pc + 1 : pEnd;
+      s = sc < sEnd ? sc + 1 : sEnd;
+      continue;
+    }
+
+    // A "**" earlier takes one more directory
+    if (starP == nullptr) {
+      return false;
+    }
+    const char* skipped = componentEnd(starS, sEnd);
+    starS = skipped < sEnd ? skipped + 1 : sEnd;
+    s = starS;
+    p = starP;
+  }
+
+  // Only "**" may be left; it matches nothing
+  while (p < pEnd) {
+    const char* pc = componentEnd(p, pEnd);
+    if (!isGlobstar(p, pc)) {
+      return false;
+    }
+    p = pc < pEnd ? pc + 1 : pEnd;
+  }
+  return true;
+}
+
+bool DicePatternSet::mayContain(const char* dir) const {
+  while (*dir == '/') dir++;
+  const char* dirEnd = dir + strlen(dir);
+
+  for (uint8_t i = 0; i < _count; i++) {
+    const char* p = _text + _patterns[i].offset;
+    const char* pEnd = p + _patterns[i].length;
+    const char* s = dir;
+
+    // Each directory level has to match one pattern component, and a
+    // component has to remain for the file itself
+    bool possible = true;
+    while (s < dirEnd) {
+      if (p >= pEnd) {
+        possible = false;
+        break;
+      }
+      const char* pc = componentEnd(p, pEnd);
+      if (isGlobstar(p, pc)) {
+        break;
+      }
+      const char* sc = componentEnd(s, dirEnd);
+      if (pc == pEnd || !matchSegment(p, pc, s, sc)) {
+        possible = false;
+        break;
+      }
+      p = pc + 1;
+      s = sc < dirEnd ? sc + 1 : dirEnd;
+    }
+    if (possible && p < pEnd) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Explicit stack of open directories, no recursion
+bool DicePatternSet::walk(DiceConfigStorage& storage, DiceFileVisitor visit, void* context) const {
+  struct Level {
+    DiceConfigStorage::Dir dir;
+    size_t pathLength;
+  };
+  Level stack[DICE_CONFIG_WALK_DEPTH + 1];
+  char path[128] = "/";
+  int depth = 0;
+
+  if (!storage.openDir(stack[0].dir, "/")) {
+    return false;
+  }
+  stack[0].pathLength = 1;
+
+  DiceFileInfo entry;
+  while (depth >= 0) {
+    Level& level = stack[depth];
+    if (!level.dir.next(entry)) {
+      level.dir.close();
+      depth--;
+      continue;
+    }
+
+    // Child path; patterns and visitors see it without the leading '/'
+    size_t length = level.pathLength;
+    int written = snprintf(path + length, sizeof(path) - length, "%s%s",
+                           length > 1 ? "/" : "", entry.name);
+    if (written < 0 || (size_t)written >= sizeof(path) - length) {
+      continue;
+    }
+    const char* relative = path + 1;
+
+    if (entry.isDirectory) {
+      if (depth < DICE_CONFIG_WALK_DEPTH && mayContain(relative) &&
+          storage.openDir(stack[depth + 1].dir, path)) {
+        depth++;
+        stack[depth].pathLength = length + written;
+      }
+      continue;
+    }
+
+    int priority = match(relative);
+    if (priority >= 0) {
+      visit(relative, priority, entry, context);
+    }
+  }
+
+  return true;
+}
+
+// '*' and '?' within one component; greedy with single-star backtracking
+bool DicePatternSet::matchSegment(const char* p, const char* pEnd, const char* s, const char* sEnd) {
+  const char* starP = nullptr;
+  const char* starS = nullptr;
+  while (s < sEnd) {
+    if (p < pEnd && *p == '*') {
+      starP = ++p;
+      starS = s;
+    } else if (p < pEnd && (*p == '?' || *p == *s)) {
+      p++;
+      s++;
+    } else if (starP != nullptr) {
+      p = starP;
+      s = ++starS;
+    } else {
+      return false;
+    }
+  }
+  while (p < pEnd && *p == '*') p++;
+  return p == pEnd;
+}
+
+const char* DicePatternSet::componentEnd(const char* p, const char* end) {
+  while (p < end && *p != '/') p++;
+  return p;
+}
+
+bool DicePatternSet::isGlobstar(const char* p, const char* pEnd) {
+  return pEnd - p == 2 && p[0] == '*' && p[1] == '*';
+}
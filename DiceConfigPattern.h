@@ -0,0 +1,96 @@
+/*
+ * DiceConfigPattern - Filename patterns for config file discovery
+ * A ';'-separated list of globs, highest priority first, compiled once
+ * into a fixed buffer and matched against raw paths without allocating:
+ *
+ *   *            any run of characters within one path component
+ *   ?            one character
+ *   **           as a whole component: any number of directories
+ *
+ *   "*_config.txt;configs/dice?.txt"
+ *
+ * Paths are relative to the filesystem root, without a leading '/'.
+ */
+
+#ifndef DICE_CONFIG_PATTERN_H
+#define DICE_CONFIG_PATTERN_H
+
+#include "DiceConfigPlatform.h"
+#include "DiceConfigStorage.h"
+
+// Default discovery pattern
+#ifndef DICE_CONFIG_PATTERNS
+#define DICE_CONFIG_PATTERNS "*_config.txt"
+#endif
+
+// Compiled pattern storage
+#ifndef DICE_CONFIG_PATTERN_MAX
+#define DICE_CONFIG_PATTERN_MAX 4
+#endif
+#ifndef DICE_CONFIG_PATTERN_TEXT
+#define DICE_CONFIG_PATTERN_TEXT 128
+#endif
+
+// Directory levels below the root that walk() enters
+#ifndef DICE_CONFIG_WALK_DEPTH
+#define DICE_CONFIG_WALK_DEPTH 4
+#endif
+
+// Called by walk() for each matching file; path has no leading '/'
+typedef void (*DiceFileVisitor)(const char* path, int priority, const DiceFileInfo& info,
+                                void* context);
+
+class DicePatternSet {
+public:
+  // Depth reported for patterns containing "**"
+  static const uint8_t ANY_DEPTH = 255;
+
+  DicePatternSet();
+
+  // Replace the set. Leading '/' and repeated '/' are dropped. Fails
+  // (leaving the set empty) on an empty list, too many patterns or
+  // patterns that don't fit DICE_CONFIG_PATTERN_TEXT.
+  bool compile(const char* patterns);
+
+  // Priority (0 = first pattern) of the first pattern matching path,
+  // or -1 if none does
+  int match(const char* path) const;
+
+  // Could a file below directory dir (relative, no trailing '/') match?
+  // Used to prune the directory walk.
+  bool mayContain(const char* dir) const;
+
+  // Depth-first walk of storage from the root, entering only directories
+  // mayContain() allows, up to DICE_CONFIG_WALK_DEPTH levels. Returns
+  // false if the root can't be opened.
+  bool walk(DiceConfigStorage& storage, DiceFileVisitor visit, void* context) const;
+
+  size_t count() const { return _count; }
+  uint8_t maxDepth() const { return _maxDepth; }
+  uint32_t hash() const { return _hash; }
+
+  // Pattern text by priority
+  const char* pattern(size_t index) const;
+
+private:
+  struct Pattern {
+    uint8_t offset;         // Start in _text (NUL-terminated)
+    uint8_t length;
+    uint8_t depth;          // '/' count, or ANY_DEPTH with "**"
+    uint8_t tailLength;     // Literal suffix every match ends with
+  };
+
+  char _text[DICE_CONFIG_PATTERN_TEXT];
+  Pattern _patterns[DICE_CONFIG_PATTERN_MAX];
+  uint8_t _count;
+  uint8_t _maxDepth;
+  uint32_t _hash;
+
+  bool matchPattern(const Pattern& pattern, const char* path, size_t pathLength,
+                    uint8_t pathDepth) const;
+  static bool matchSegment(const char* p, const char* pEnd, const char* s, const char* sEnd);
+  static const char* componentEnd(const char* p, const char* end);
+  static bool isGlobstar(const char* p, const char* pEnd);
+};
+
+#endif // DICE_CONFIG_PATTERN_H
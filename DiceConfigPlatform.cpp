@@ -0,0 +1,99 @@
+/*
+ * DiceConfigPlatform - Host implementations (unused on Arduino)
+ */
+
+#include "DiceConfigPlatform.h"
+
+#if !defined(ARDUINO)
+
+#include <chrono>
+#include <thread>
+
+DiceHostSerial Serial;
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+  while (size--) {
+    written += write(*buffer++);
+  }
+  return written;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  
+  if (len < 0) {
+    return 0;
+  }
+  if ((size_t)len < sizeof(buffer)) {
+    return write((const uint8_t*)buffer, len);
+  }
+  
+  // Long output: format again into a heap buffer
+  char* heap = (char*)malloc(len + 1);
+  if (heap == nullptr) {
+    return 0;
+  }
+  va_start(args, format);
+  vsnprintf(heap, len + 1, format, args);
+  va_end(args);
+  size_t written = write((const uint8_t*)heap, len);
+  free(heap);
+  return written;
+}
+
+String::String(const char* str) {
+  _buffer = strdup(str != nullptr ? str : "");
+}
+
+String::String(const String& other) {
+  _buffer = strdup(other._buffer);
+}
+
+String& String::operator=(const String& other) {
+  if (this != &other) {
+    free(_buffer);
+    _buffer = strdup(other._buffer);
+  }
+  return *this;
+}
+
+String::~String() {
+  free(_buffer);
+}
+
+bool String::endsWith(const char* suffix) const {
+  size_t len = strlen(_buffer);
+  size_t suffixLen = strlen(suffix);
+  return suffixLen <= len && strcmp(_buffer + len - suffixLen, suffix) == 0;
+}
+
+size_t DiceHostSerial::write(uint8_t c) {
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t DiceHostSerial::write(const uint8_t* buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,80 @@
+/*
+ * DiceConfigPlatform - Arduino core on target, minimal stand-ins on host
+ * Lets the library (parser, storage, tools) build on Linux for
+ * benchmarking and CI. Only what the library itself uses is provided.
+ */
+
+#ifndef DICE_CONFIG_PLATFORM_H
+#define DICE_CONFIG_PLATFORM_H
+
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <time.h>
+
+#define DICE_CONFIG_HOST 1
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// Subset of Arduino's Print
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  virtual int availableForWrite() { return 0; }
+  
+  size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+  size_t print(const char* str) { return write(str); }
+  size_t println(const char* str) { return write(str) + write("\n"); }
+  size_t println() { return write("\n"); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// Subset of Arduino's String (only what the public API returns)
+class String {
+public:
+  String(const char* str = "");
+  String(const String& other);
+  String& operator=(const String& other);
+  ~String();
+  
+  const char* c_str() const { return _buffer; }
+  unsigned int length() const { return (unsigned int)strlen(_buffer); }
+  bool endsWith(const char* suffix) const;
+
+private:
+  char* _buffer;
+};
+
+// stdout stand-in for the Serial port
+class DiceHostSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buffer, size_t size);
+  int availableForWrite() { return 4096; }
+  using Print::write;
+};
+
+extern DiceHostSerial Serial;
+
+#endif // ARDUINO
+
+// Size of the library's path buffers, terminator included
+#define DICE_CONFIG_PATH_MAX 64
+
+#endif // DICE_CONFIG_PLATFORM_H
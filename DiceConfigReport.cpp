@@ -0,0 +1,94 @@
+/*
+ * DiceConfigReport - Implementation
+ */
+
+#include "DiceConfigReport.h"
+#include "DiceConfigManager.h"
+
+DiceConfigReport::DiceConfigReport() {
+  _buffer[0] = '\0';
+  _length = 0;
+  _sent = 0;
+}
+
+size_t DiceConfigReport::render(const DiceConfig& config) {
+  _length = format(config, _buffer, sizeof(_buffer));
+  if (_length >= sizeof(_buffer)) {
+    _length = sizeof(_buffer) - 1;
+  }
+  _sent = 0;
+  return _length;
+}
+
+bool DiceConfigReport::drain(Print& out, size_t maxBytes) {
+  if (maxBytes == 0) {
+    // Plain Print sinks report 0; a full UART costs at most one small chunk
+    int room = out.availableForWrite();
+    maxBytes = room > 0 ? (size_t)room : DICE_CONFIG_REPORT_CHUNK;
+  }
+  
+  size_t remaining = _length - _sent;
+  size_t chunk = remaining < maxBytes ? remaining : maxBytes;
+  if (chunk > 0) {
+    _sent += out.write((const uint8_t*)_buffer + _sent, chunk);
+  }
+  return done();
+}
+
+bool DiceConfigReport::done() {
+  return _sent >= _length;
+}
+
+const char* DiceConfigReport::c_str() {
+  return _buffer;
+}
+
+size_t DiceConfigReport::length() {
+  return _length;
+}
+
+size_t DiceConfigReport::format(const DiceConfig& config, char* buffer, size_t size) {
+  const uint8_t* a = config.deviceA_mac;
+  const uint8_t* b1 = config.deviceB1_mac;
+  const uint8_t* b2 = config.deviceB2_mac;
+  
+  int len = snprintf(buffer, size,
+    "=== Dice Configuration ===\n"
+    "Dice ID: %s\n"
+    "Device A MAC: %02X:%02X:%02X:%02X:%02X:%02X\n"
+    "Device B1 MAC: %02X:%02X:%02X:%02X:%02X:%02X\n"
+    "Device B2 MAC: %02X:%02X:%02X:%02X:%02X:%02X\n"
+    "X Background: 0x%04X (%u)\n"
+    "Y Background: 0x%04X (%u)\n"
+    "Z Background: 0x%04X (%u)\n"
+    "Entangle AB1 Color: 0x%04X (%u)\n"
+    "Entangle AB2 Color: 0x%04X (%u)\n"
+    "RSSI Limit: %d dBm\n"
+    "Is SMD: %s\n"
+    "Is Nano: %s\n"
+    "Always Seven: %s\n"
+    "Random Switch Point: %u%%\n"
+    "Tumble Constant: %.2f\n"
+    "Deep Sleep Timeout: %u ms\n"
+    "Checksum: 0x%02X\n"
+    "==========================\n",
+    config.diceId,
+    a[0], a[1], a[2], a[3], a[4], a[5],
+    b1[0], b1[1], b1[2], b1[3], b1[4], b1[5],
+    b2[0], b2[1], b2[2], b2[3], b2[4], b2[5],
+    config.x_background, config.x_background,
+    config.y_background, config.y_background,
+    config.z_background, config.z_background,
+    config.entang_ab1_color, config.entang_ab1_color,
+    config.entang_ab2_color, config.entang_ab2_color,
+    config.rssiLimit,
+    config.isSMD ? "true" : "false",
+    config.isNano ? "true" : "false",
+    config.alwaysSeven ? "true" : "false",
+    config.randomSwitchPoint,
+    config.tumbleConstant,
+    (unsigned)config.deepSleepTimeout,
+    config.checksum);
+  
+  return len < 0 ? 0 : (size_t)len;
+}
@@ -0,0 +1,51 @@
+/*
+ * DiceConfigReport - Human-readable config report rendered into one buffer
+ * The report can be written to any Print sink or callback in one go, or
+ * drained a few bytes at a time so the caller never blocks on a UART.
+ */
+
+#ifndef DICE_CONFIG_REPORT_H
+#define DICE_CONFIG_REPORT_H
+
+#include "DiceConfigPlatform.h"
+
+struct DiceConfig;
+
+#ifndef DICE_CONFIG_REPORT_SIZE
+#define DICE_CONFIG_REPORT_SIZE 768
+#endif
+
+// drain() chunk for sinks whose availableForWrite() reports 0
+#ifndef DICE_CONFIG_REPORT_CHUNK
+#define DICE_CONFIG_REPORT_CHUNK 16
+#endif
+
+// Output callback for sinks that are not a Print (web responses, files, ...)
+typedef void (*DiceConfigWriter)(const char* data, size_t len, void* context);
+
+class DiceConfigReport {
+public:
+  DiceConfigReport();
+  
+  // Format the full report; returns its length
+  size_t render(const DiceConfig& config);
+  
+  // Non-blocking output: writes at most maxBytes (default: what the sink
+  // reports as availableForWrite(), or DICE_CONFIG_REPORT_CHUNK if that
+  // is 0). Returns true once everything is sent.
+  bool drain(Print& out, size_t maxBytes = 0);
+  bool done();
+  
+  const char* c_str();
+  size_t length();
+  
+  // Format into a caller-provided buffer (snprintf semantics)
+  static size_t format(const DiceConfig& config, char* buffer, size_t size);
+
+private:
+  char _buffer[DICE_CONFIG_REPORT_SIZE];
+  size_t _length;
+  size_t _sent;
+};
+
+#endif // DICE_CONFIG_REPORT_H
@@ -0,0 +1,95 @@
+/*
+ * DiceConfigRtc - Validated DiceConfig kept in RTC slow memory
+ */
+
+#include "DiceConfigRtc.h"
+#include "DiceConfigManager.h"
+
+#if defined(ESP_PLATFORM)
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+// Not zeroed on wake or reset; the CRC tells garbage from a real image
+#define DICE_RTC_ATTR RTC_NOINIT_ATTR
+#else
+#define DICE_RTC_ATTR
+#endif
+
+static const uint32_t RTC_IMAGE_MAGIC = 0x44435231; // "DCR1"
+
+struct RtcImage {
+  uint32_t magic;
+  uint32_t layout;       // sizeof(DiceConfig): struct changed -> reject
+  uint32_t generation;
+  char path[64];
+  DiceConfig config;
+  uint32_t crc;          // Over everything above
+};
+
+static DICE_RTC_ATTR RtcImage rtcImage;
+
+static uint32_t imageCrc(const RtcImage& image) {
+  return DiceConfigRtc::crc32(0, &image, offsetof(RtcImage, crc));
+}
+
+void DiceConfigRtc::store(const DiceConfig& config, const char* path, uint32_t generation) {
+  // Build the image on the stack (zeroed, so padding is deterministic)
+  // and copy it over in one go
+  RtcImage image;
+  memset(&image, 0, sizeof(image));
+  image.magic = RTC_IMAGE_MAGIC;
+  image.layout = sizeof(DiceConfig);
+  image.generation = generation;
+  strncpy(image.path, path, sizeof(image.path) - 1);
+  image.config = config;
+  image.crc = imageCrc(image);
+  
+  memcpy(&rtcImage, &image, sizeof(image));
+}
+
+bool DiceConfigRtc::restore(DiceConfig& config, char* path, size_t pathSize, uint32_t generation) {
+#if defined(ESP_PLATFORM)
+  // The memory also survives panics, watchdog and software resets, after
+  // which the image may predate a save; only a deep-sleep wake trusts it
+  if (esp_reset_reason() != ESP_RST_DEEPSLEEP) {
+    invalidate();
+    return false;
+  }
+#endif
+  if (!isValid(generation)) {
+    return false;
+  }
+  
+  config = rtcImage.config;
+  strncpy(path, rtcImage.path, pathSize - 1);
+  path[pathSize - 1] = '\0';
+  return true;
+}
+
+void DiceConfigRtc::invalidate() {
+  memset(&rtcImage, 0, sizeof(rtcImage));
+}
+
+bool DiceConfigRtc::isValid(uint32_t generation) {
+  return rtcImage.magic == RTC_IMAGE_MAGIC &&
+         rtcImage.layout == sizeof(DiceConfig) &&
+         rtcImage.generation == generation &&
+         rtcImage.crc == imageCrc(rtcImage);
+}
+
+uint32_t DiceConfigRtc::crc32(uint32_t crc, const void* data, size_t len) {
+#if defined(ESP_PLATFORM)
+  return esp_rom_crc32_le(crc, (const uint8_t*)data, len);
+#else
+  // Bitwise; the image is ~120 bytes so a table isn't worth the RAM
+  const uint8_t* ptr = (const uint8_t*)data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= ptr[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+#endif
+}
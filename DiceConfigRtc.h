@@ -0,0 +1,38 @@
+/*
+ * DiceConfigRtc - Validated DiceConfig kept in RTC slow memory
+ * RTC slow memory keeps its contents through deep sleep, so a config
+ * stored before sleeping can be restored on wake without touching flash.
+ * On host a static buffer stands in for it; invalidate() simulates a
+ * power-on reset.
+ */
+
+#ifndef DICE_CONFIG_RTC_H
+#define DICE_CONFIG_RTC_H
+
+#include "DiceConfigPlatform.h"
+
+struct DiceConfig;
+
+// Bump (or pass your own to enableRtcCache()) to make images stored by
+// an older firmware fall back to flash
+#ifndef DICE_CONFIG_RTC_GENERATION
+#define DICE_CONFIG_RTC_GENERATION 1
+#endif
+
+class DiceConfigRtc {
+public:
+  // Store config and its source path with a CRC
+  static void store(const DiceConfig& config, const char* path, uint32_t generation);
+  
+  // Copy the stored image out if its CRC, layout and generation match
+  // and (on ESP32) the chip is waking from deep sleep
+  static bool restore(DiceConfig& config, char* path, size_t pathSize, uint32_t generation);
+  
+  static void invalidate();
+  static bool isValid(uint32_t generation);
+  
+  // CRC-32 (IEEE, little-endian), ROM routine on ESP32
+  static uint32_t crc32(uint32_t crc, const void* data, size_t len);
+};
+
+#endif // DICE_CONFIG_RTC_H
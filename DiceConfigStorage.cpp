@@ -0,0 +1,499 @@
+/*
+ * DiceConfigStorage - Storage backends for DiceConfigManager
+ */
+
+#include "DiceConfigStorage.h"
+
+#if !defined(ARDUINO)
+#include <sys/stat.h>
+#endif
+
+// Copy the last path component of name into out
+static void copyBaseName(const char* name, char* out, size_t size) {
+  const char* slash = strrchr(name, '/');
+  const char* base = slash ? slash + 1 : name;
+  size_t len = strlen(base);
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(out, base, len);
+  out[len] = '\0';
+}
+
+// ============================================================================
+// LittleFS
+// ============================================================================
+
+#if defined(ARDUINO)
+
+DiceLittleFSStorage::DiceLittleFSStorage() : _mounted(false), _shared(false) {
+}
+
+bool DiceLittleFSStorage::mount(bool formatOnFail) {
+  if (isMounted()) {
+    return true;
+  }
+  _mounted = LittleFS.begin(formatOnFail, DICE_CONFIG_LITTLEFS_BASE,
+                            DICE_CONFIG_LITTLEFS_MAX_FILES, DICE_CONFIG_LITTLEFS_LABEL);
+  _shared = false;
+  return _mounted;
+}
+
+bool DiceLittleFSStorage::isMounted() {
+#if defined(ESP_PLATFORM)
+  // Ask the VFS driver: someone else may have mounted (or unmounted) it
+  bool mounted = esp_littlefs_mounted(DICE_CONFIG_LITTLEFS_LABEL);
+  if (mounted && !_mounted) {
+    _shared = true;
+  }
+  _mounted = mounted;
+  return mounted;
+#else
+  return _mounted;
+#endif
+}
+
+bool DiceLittleFSStorage::open(File& file, const char* path, const char* mode) {
+  file._file = LittleFS.open(path, mode);
+  return (bool)file._file;
+}
+
+bool DiceLittleFSStorage::openDir(Dir& dir, const char* path) {
+  dir._dir = LittleFS.open(path);
+  if (!dir._dir) {
+    return false;
+  }
+  if (!dir._dir.isDirectory()) {
+    dir._dir.close();
+    return false;
+  }
+  return true;
+}
+
+bool DiceLittleFSStorage::Dir::next(DiceFileInfo& info) {
+  fs::File entry = _dir.openNextFile();
+  if (!entry) {
+    return false;
+  }
+  
+  copyBaseName(entry.name(), info.name, sizeof(info.name));
+  info.isDirectory = entry.isDirectory();
+  info.size = entry.size();
+  info.lastWrite = entry.getLastWrite();
+  entry.close();
+  return true;
+}
+
+#else
+
+// ============================================================================
+// POSIX
+// ============================================================================
+
+size_t DicePosixStorage::File::size() {
+  struct stat st;
+  if (fstat(fileno(_fp), &st) != 0) {
+    return 0;
+  }
+  return (size_t)st.st_size;
+}
+
+time_t DicePosixStorage::File::lastWrite() {
+  struct stat st;
+  if (fstat(fileno(_fp), &st) != 0) {
+    return 0;
+  }
+  return st.st_mtime;
+}
+
+void DicePosixStorage::File::close() {
+  if (_fp) {
+    fclose(_fp);
+    _fp = nullptr;
+  }
+}
+
+bool DicePosixStorage::Dir::next(DiceFileInfo& info) {
+  if (!_dir) {
+    return false;
+  }
+  
+  struct dirent* entry;
+  while ((entry = readdir(_dir)) != nullptr) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    
+    char full[sizeof(_path) + sizeof(entry->d_name) + 1];
+    snprintf(full, sizeof(full), "%s/%s", _path, entry->d_name);
+    struct stat st;
+    if (stat(full, &st) != 0) {
+      continue;
+    }
+    
+    copyBaseName(entry->d_name, info.name, sizeof(info.name));
+    info.isDirectory = S_ISDIR(st.st_mode);
+    info.size = (uint32_t)st.st_size;
+    info.lastWrite = st.st_mtime;
+    return true;
+  }
+  return false;
+}
+
+void DicePosixStorage::Dir::close() {
+  if (_dir) {
+    closedir(_dir);
+    _dir = nullptr;
+  }
+}
+
+DicePosixStorage::DicePosixStorage() : _mounted(false) {
+  strcpy(_root, ".");
+}
+
+void DicePosixStorage::setRoot(const char* root) {
+  strncpy(_root, root, sizeof(_root) - 1);
+  _root[sizeof(_root) - 1] = '\0';
+  
+  // Drop a trailing slash so root + "/name" stays clean
+  size_t len = strlen(_root);
+  if (len > 1 && _root[len - 1] == '/') {
+    _root[len - 1] = '\0';
+  }
+}
+
+bool DicePosixStorage::mount(bool formatOnFail) {
+  struct stat st;
+  if (stat(_root, &st) != 0) {
+    if (!formatOnFail || mkdir(_root, 0755) != 0) {
+      return false;
+    }
+  } else if (!S_ISDIR(st.st_mode)) {
+    return false;
+  }
+  _mounted = true;
+  return true;
+}
+
+bool DicePosixStorage::resolve(const char* path, char* out, size_t size) {
+  int len = snprintf(out, size, "%s%s%s", _root, path[0] == '/' ? "" : "/", path);
+  return len > 0 && (size_t)len < size;
+}
+
+bool DicePosixStorage::open(File& file, const char* path, const char* mode) {
+  file.close();
+  
+  char full[256];
+  if (!resolve(path, full, sizeof(full))) {
+    return false;
+  }
+  
+  // Binary mode so sizes and offsets match the embedded filesystem
+  char fmode[4] = { mode[0], 'b', '\0', '\0' };
+  file._fp = fopen(full, fmode);
+  return file._fp != nullptr;
+}
+
+bool DicePosixStorage::openDir(Dir& dir, const char* path) {
+  dir.close();
+  
+  if (!resolve(path, dir._path, sizeof(dir._path))) {
+    return false;
+  }
+  dir._dir = opendir(dir._path);
+  return dir._dir != nullptr;
+}
+
+bool DicePosixStorage::exists(const char* path) {
+  char full[256];
+  struct stat st;
+  return resolve(path, full, sizeof(full)) && stat(full, &st) == 0;
+}
+
+bool DicePosixStorage::remove(const char* path) {
+  char full[256];
+  return resolve(path, full, sizeof(full)) && ::remove(full) == 0;
+}
+
+bool DicePosixStorage::rename(const char* from, const char* to) {
+  char fullFrom[256];
+  char fullTo[256];
+  return resolve(from, fullFrom, sizeof(fullFrom)) &&
+         resolve(to, fullTo, sizeof(fullTo)) &&
+         ::rename(fullFrom, fullTo) == 0;
+}
+
+bool DicePosixStorage::dirStamp(const char* path, uint32_t& stamp) {
+  char full[256];
+  struct stat st;
+  if (!resolve(path, full, sizeof(full)) || stat(full, &st) != 0) {
+    return false;
+  }
+  
+  // Fold mtime (with nanoseconds where available) and inode
+#if defined(__APPLE__)
+  uint64_t nanos = (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+  uint64_t nanos = (uint64_t)st.st_mtim.tv_nsec;
+#endif
+  uint64_t mix = (uint64_t)st.st_mtime * 1000000000ULL + nanos;
+  mix ^= (uint64_t)st.st_ino * 0x9E3779B97F4A7C15ULL;
+  stamp = (uint32_t)(mix ^ (mix >> 32));
+  return true;
+}
+
+#endif // ARDUINO
+
+// ============================================================================
+// In-memory
+// ============================================================================
+
+DiceMemoryStorage::DiceMemoryStorage() : _clock(0), _dirVersion(0) {
+  memset(_entries, 0, sizeof(_entries));
+}
+
+DiceMemoryStorage::~DiceMemoryStorage() {
+  for (int i = 0; i < DICE_MEMORY_STORAGE_FILES; i++) {
+    free(_entries[i].data);
+  }
+}
+
+int DiceMemoryStorage::find(const char* path) {
+  for (int i = 0; i < DICE_MEMORY_STORAGE_FILES; i++) {
+    if (_entries[i].path[0] && strcmp(_entries[i].path, path) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool DiceMemoryStorage::open(File& file, const char* path, const char* mode) {
+  file.close();
+  
+  if (strlen(path) >= sizeof(_entries[0].path)) {
+    return false;
+  }
+  
+  int index = find(path);
+  if (mode[0] == 'r') {
+    if (index < 0) {
+      return false;
+    }
+  } else {
+    if (index < 0) {
+      for (int i = 0; i < DICE_MEMORY_STORAGE_FILES; i++) {
+        if (!_entries[i].path[0]) {
+          index = i;
+          break;
+        }
+      }
+      if (index < 0) {
+        return false;
+      }
+      strcpy(_entries[index].path, path);
+      _entries[index].size = 0;
+      _dirVersion++;
+    } else if (mode[0] == 'w') {
+      _entries[index].size = 0;
+    }
+    _entries[index].lastWrite = ++_clock;
+  }
+  
+  file._owner = this;
+  file._index = index;
+  file._pos = (mode[0] == 'a') ? _entries[index].size : 0;
+  return true;
+}
+
+int DiceMemoryStorage::File::read(void* buffer, size_t len) {
+  if (!_owner) {
+    return -1;
+  }
+  Entry& entry = _owner->_entries[_index];
+  if (_pos >= entry.size) {
+    return 0;
+  }
+  if (len > entry.size - _pos) {
+    len = entry.size - _pos;
+  }
+  memcpy(buffer, entry.data + _pos, len);
+  _pos += len;
+  return (int)len;
+}
+
+size_t DiceMemoryStorage::File::write(const void* data, size_t len) {
+  if (!_owner) {
+    return 0;
+  }
+  Entry& entry = _owner->_entries[_index];
+  size_t end = _pos + len;
+  if (end > entry.capacity) {
+    size_t capacity = entry.capacity ? entry.capacity : 256;
+    while (capacity < end) {
+      capacity *= 2;
+    }
+    uint8_t* grown = (uint8_t*)realloc(entry.data, capacity);
+    if (!grown) {
+      return 0;
+    }
+    entry.data = grown;
+    entry.capacity = capacity;
+  }
+  
+  memcpy(entry.data + _pos, data, len);
+  _pos = end;
+  if (end > entry.size) {
+    entry.size = end;
+  }
+  entry.lastWrite = ++_owner->_clock;
+  return len;
+}
+
+size_t DiceMemoryStorage::File::size() {
+  return _owner ? _owner->_entries[_index].size : 0;
+}
+
+time_t DiceMemoryStorage::File::lastWrite() {
+  return _owner ? _owner->_entries[_index].lastWrite : 0;
+}
+
+bool DiceMemoryStorage::File::seek(size_t pos) {
+  if (!_owner || pos > _owner->_entries[_index].size) {
+    return false;
+  }
+  _pos = pos;
+  return true;
+}
+
+bool DiceMemoryStorage::openDir(Dir& dir, const char* path) {
+  // Normalize to "/dir/" so entries match by prefix
+  int len = snprintf(dir._path, sizeof(dir._path), "%s%s", path,
+                     path[strlen(path) - 1] == '/' ? "" : "/");
+  if (len <= 0 || (size_t)len >= sizeof(dir._path)) {
+    return false;
+  }
+  dir._owner = this;
+  dir._next = 0;
+  return true;
+}
+
+bool DiceMemoryStorage::Dir::next(DiceFileInfo& info) {
+  if (!_owner) {
+    return false;
+  }
+  
+  size_t prefixLen = strlen(_path);
+  while (_next < DICE_MEMORY_STORAGE_FILES) {
+    int index = _next++;
+    const Entry& entry = _owner->_entries[index];
+    if (!entry.path[0] || strncmp(entry.path, _path, prefixLen) != 0) {
+      continue;
+    }
+    
+    const char* rest = entry.path + prefixLen;
+    const char* slash = strchr(rest, '/');
+    if (!slash) {
+      copyBaseName(rest, info.name, sizeof(info.name));
+      info.isDirectory = false;
+      info.size = entry.size;
+      info.lastWrite = entry.lastWrite;
+      return true;
+    }
+    
+    // Deeper file: report its first component as a subdirectory, once
+    size_t nameLen = slash - rest;
+    bool seen = false;
+    for (int i = 0; i < index && !seen; i++) {
+      const char* other = _owner->_entries[i].path;
+      seen = other[0] && strncmp(other, _path, prefixLen) == 0 &&
+             strncmp(other + prefixLen, rest, nameLen + 1) == 0;
+    }
+    if (seen || nameLen >= sizeof(info.name)) {
+      continue;
+    }
+    memcpy(info.name, rest, nameLen);
+    info.name[nameLen] = '\0';
+    info.isDirectory = true;
+    info.size = 0;
+    info.lastWrite = entry.lastWrite;
+    return true;
+  }
+  return false;
+}
+
+bool DiceMemoryStorage::remove(const char* path) {
+  int index = find(path);
+  if (index < 0) {
+    return false;
+  }
+  free(_entries[index].data);
+  memset(&_entries[index], 0, sizeof(Entry));
+  _dirVersion++;
+  return true;
+}
+
+bool DiceMemoryStorage::rename(const char* from, const char* to) {
+  int index = find(from);
+  if (index < 0 || strlen(to) >= sizeof(_entries[0].path)) {
+    return false;
+  }
+  
+  int existing = find(to);
+  if (existing >= 0 && existing != index) {
+    remove(to);
+  }
+  strcpy(_entries[index].path, to);
+  _dirVersion++;
+  return true;
+}
+
+// ============================================================================
+// Line reader
+// ============================================================================
+
+DiceLineReader::DiceLineReader(DiceConfigStorage::File& file, size_t limit)
+  : _file(file), _pos(0), _len(0), _offset(0), _remaining(limit) {
+}
+
+bool DiceLineReader::fill() {
+  size_t want = _remaining < sizeof(_buffer) ? _remaining : sizeof(_buffer);
+  int count = want > 0 ? _file.read(_buffer, want) : 0;
+  _offset += _len;
+  _pos = 0;
+  _len = count > 0 ? (size_t)count : 0;
+  _remaining -= _len;
+  return _len > 0;
+}
+
+int DiceLineReader::readLine(char* line, size_t size) {
+  if (_pos >= _len && !fill()) {
+    return -1;
+  }
+  
+  size_t count = 0;
+  while (count < size - 1) {
+    if (_pos >= _len && !fill()) {
+      break;
+    }
+    
+    // Copy up to the next newline in one go
+    const uint8_t* start = _buffer + _pos;
+    size_t avail = _len - _pos;
+    size_t room = size - 1 - count;
+    size_t take = avail < room ? avail : room;
+    const uint8_t* newline = (const uint8_t*)memchr(start, '\n', take);
+    if (newline) {
+      size_t n = newline - start;
+      memcpy(line + count, start, n);
+      count += n;
+      _pos += n + 1;
+      break;
+    }
+    memcpy(line + count, start, take);
+    count += take;
+    _pos += take;
+  }
+  
+  line[count] = '\0';
+  return (int)count;
+}
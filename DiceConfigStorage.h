@@ -0,0 +1,278 @@
+/*
+ * DiceConfigStorage - Storage backends for DiceConfigManager
+ * 
+ * Every backend has the same non-virtual interface (File, Dir, mount,
+ * open, openDir, exists, remove, rename, dirStamp). One is picked at compile time
+ * as DiceConfigStorage, so the embedded build has no virtual dispatch:
+ * 
+ *   DiceLittleFSStorage  - LittleFS on ESP32 (default on Arduino)
+ *   DicePosixStorage     - a directory on a POSIX host (default on host)
+ *   DiceMemoryStorage    - RAM disk, both targets
+ * 
+ * -DDICE_CONFIG_STORAGE_MEMORY selects the RAM disk. The LittleFS and
+ * POSIX backends only exist on their own target, so
+ * -DDICE_CONFIG_STORAGE_LITTLEFS and -DDICE_CONFIG_STORAGE_POSIX just
+ * restate the default there and are an error anywhere else.
+ */
+
+#ifndef DICE_CONFIG_STORAGE_H
+#define DICE_CONFIG_STORAGE_H
+
+#include "DiceConfigPlatform.h"
+
+#if defined(ARDUINO)
+#include <LittleFS.h>
+#if defined(ESP_PLATFORM)
+#include <esp_littlefs.h>
+#endif
+#else
+#include <dirent.h>
+#endif
+
+// Directory entry as reported by Dir::next()
+struct DiceFileInfo {
+  char name[64];        // Base name, without directory
+  bool isDirectory;
+  uint32_t size;
+  time_t lastWrite;
+};
+
+#if defined(ARDUINO)
+
+// Partition and mount point used by LittleFS.begin() (Arduino defaults)
+#ifndef DICE_CONFIG_LITTLEFS_LABEL
+#define DICE_CONFIG_LITTLEFS_LABEL "spiffs"
+#endif
+#ifndef DICE_CONFIG_LITTLEFS_BASE
+#define DICE_CONFIG_LITTLEFS_BASE "/littlefs"
+#endif
+#ifndef DICE_CONFIG_LITTLEFS_MAX_FILES
+#define DICE_CONFIG_LITTLEFS_MAX_FILES 10
+#endif
+
+class DiceLittleFSStorage {
+public:
+  class File {
+  public:
+    bool isOpen() { return (bool)_file; }
+    int read(void* buffer, size_t len) { return _file.read((uint8_t*)buffer, len); }
+    size_t write(const void* data, size_t len) { return _file.write((const uint8_t*)data, len); }
+    size_t size() { return _file.size(); }
+    time_t lastWrite() { return _file.getLastWrite(); }
+    bool seek(size_t pos) { return _file.seek(pos); }
+    void close() { _file.close(); }
+  
+  private:
+    friend class DiceLittleFSStorage;
+    fs::File _file;
+  };
+  
+  class Dir {
+  public:
+    bool next(DiceFileInfo& info);
+    void close() { _dir.close(); }
+  
+  private:
+    friend class DiceLittleFSStorage;
+    fs::File _dir;
+  };
+  
+  DiceLittleFSStorage();
+  
+  // Reuses a mount made by the application or another library
+  bool mount(bool formatOnFail);
+  bool isMounted();
+  bool isShared() { return _shared; }
+  bool open(File& file, const char* path, const char* mode);
+  bool openDir(Dir& dir, const char* path);
+  bool exists(const char* path) { return LittleFS.exists(path); }
+  bool remove(const char* path) { return LittleFS.remove(path); }
+  bool rename(const char* from, const char* to) { return LittleFS.rename(from, to); }
+  
+  // LittleFS keeps no directory modification time
+  bool dirStamp(const char* path, uint32_t& stamp) { (void)path; stamp = 0; return false; }
+
+private:
+  bool _mounted;
+  bool _shared;
+};
+
+#else
+
+class DicePosixStorage {
+public:
+  class File {
+  public:
+    File() : _fp(nullptr) {}
+    ~File() { close(); }
+    bool isOpen() { return _fp != nullptr; }
+    int read(void* buffer, size_t len) { return (int)fread(buffer, 1, len, _fp); }
+    size_t write(const void* data, size_t len) { return fwrite(data, 1, len, _fp); }
+    size_t size();
+    time_t lastWrite();
+    bool seek(size_t pos) { return fseek(_fp, (long)pos, SEEK_SET) == 0; }
+    void close();
+  
+  private:
+    friend class DicePosixStorage;
+    FILE* _fp;
+    File(const File&);
+    File& operator=(const File&);
+  };
+  
+  class Dir {
+  public:
+    Dir() : _dir(nullptr) {}
+    ~Dir() { close(); }
+    bool next(DiceFileInfo& info);
+    void close();
+  
+  private:
+    friend class DicePosixStorage;
+    DIR* _dir;
+    char _path[256];
+    Dir(const Dir&);
+    Dir& operator=(const Dir&);
+  };
+  
+  DicePosixStorage();
+  
+  // Host directory that plays the role of the filesystem root
+  void setRoot(const char* root);
+  const char* getRoot() { return _root; }
+  
+  bool mount(bool formatOnFail);
+  bool isMounted() { return _mounted; }
+  bool isShared() { return false; }
+  bool open(File& file, const char* path, const char* mode);
+  bool openDir(Dir& dir, const char* path);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+  
+  // Changes whenever an entry is added, removed or renamed in path
+  bool dirStamp(const char* path, uint32_t& stamp);
+
+private:
+  char _root[192];
+  bool _mounted;
+  bool resolve(const char* path, char* out, size_t size);
+};
+
+#endif // ARDUINO
+
+#ifndef DICE_MEMORY_STORAGE_FILES
+#define DICE_MEMORY_STORAGE_FILES 16
+#endif
+
+// RAM disk: a small table of heap-backed files. Last-write "times" come
+// from a counter so change detection still works.
+class DiceMemoryStorage {
+public:
+  class File {
+  public:
+    File() : _owner(nullptr), _index(-1), _pos(0) {}
+    bool isOpen() { return _owner != nullptr; }
+    int read(void* buffer, size_t len);
+    size_t write(const void* data, size_t len);
+    size_t size();
+    time_t lastWrite();
+    bool seek(size_t pos);
+    void close() { _owner = nullptr; }
+  
+  private:
+    friend class DiceMemoryStorage;
+    DiceMemoryStorage* _owner;
+    int _index;
+    size_t _pos;
+  };
+  
+  class Dir {
+  public:
+    Dir() : _owner(nullptr), _next(0) {}
+    bool next(DiceFileInfo& info);
+    void close() { _owner = nullptr; }
+  
+  private:
+    friend class DiceMemoryStorage;
+    DiceMemoryStorage* _owner;
+    char _path[64];
+    int _next;
+  };
+  
+  DiceMemoryStorage();
+  ~DiceMemoryStorage();
+  
+  bool mount(bool formatOnFail) { (void)formatOnFail; return true; }
+  bool isMounted() { return true; }
+  bool isShared() { return false; }
+  bool open(File& file, const char* path, const char* mode);
+  bool openDir(Dir& dir, const char* path);
+  bool exists(const char* path) { return find(path) >= 0; }
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+  bool dirStamp(const char* path, uint32_t& stamp) { (void)path; stamp = _dirVersion; return true; }
+
+private:
+  struct Entry {
+    char path[64];
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    time_t lastWrite;
+  };
+  
+  Entry _entries[DICE_MEMORY_STORAGE_FILES];
+  time_t _clock;
+  uint32_t _dirVersion;       // Bumped on create, remove and rename
+  
+  int find(const char* path);
+  DiceMemoryStorage(const DiceMemoryStorage&);
+  DiceMemoryStorage& operator=(const DiceMemoryStorage&);
+};
+
+// Compile-time backend selection
+#if defined(DICE_CONFIG_STORAGE_MEMORY) + defined(DICE_CONFIG_STORAGE_POSIX) + \
+    defined(DICE_CONFIG_STORAGE_LITTLEFS) > 1
+#error "Define at most one DICE_CONFIG_STORAGE_* flag"
+#elif defined(ARDUINO) && defined(DICE_CONFIG_STORAGE_POSIX)
+#error "DICE_CONFIG_STORAGE_POSIX is for host builds; Arduino builds have no DicePosixStorage"
+#elif !defined(ARDUINO) && defined(DICE_CONFIG_STORAGE_LITTLEFS)
+#error "DICE_CONFIG_STORAGE_LITTLEFS needs an Arduino build; use the default POSIX backend on a host"
+#endif
+
+#if defined(DICE_CONFIG_STORAGE_MEMORY)
+typedef DiceMemoryStorage DiceConfigStorage;
+#elif defined(ARDUINO)
+typedef DiceLittleFSStorage DiceConfigStorage;
+#else
+typedef DicePosixStorage DiceConfigStorage;
+#endif
+
+// Buffered line reader with the same framing as Stream::readBytesUntil('\n'):
+// the terminator is consumed but not stored, and lines longer than the
+// buffer are returned in pieces.
+class DiceLineReader {
+public:
+  // Reads at most limit bytes from the current position of file
+  explicit DiceLineReader(DiceConfigStorage::File& file, size_t limit = SIZE_MAX);
+  
+  // Reads one line into line (NUL-terminated, at most size - 1 chars).
+  // Returns its length, or -1 at end of file.
+  int readLine(char* line, size_t size);
+  
+  // Bytes consumed by the lines read so far (including newlines)
+  size_t position() const { return _offset + _pos; }
+
+private:
+  DiceConfigStorage::File& _file;
+  uint8_t _buffer[128];
+  size_t _pos;
+  size_t _len;
+  size_t _offset;             // Bytes before _buffer
+  size_t _remaining;          // Of limit, not yet read
+  
+  bool fill();
+};
+
+#endif // DICE_CONFIG_STORAGE_H
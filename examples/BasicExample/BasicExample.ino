@@ -39,6 +39,9 @@ void setup() {
     return;
   }
   
+  // Print the verbose messages queued during begin()
+  configManager.drainLog(Serial);
+  
   // Show which config file was loaded
   Serial.printf("Loaded config from: %s\n\n", configManager.getConfigPath());
   
@@ -91,6 +94,7 @@ void setup() {
 }
 
 void loop() {
-  // Nothing to do here
+  // Print any verbose messages queued since the last pass
+  configManager.drainLog(Serial);
   delay(1000);
 }
@@ -0,0 +1,45 @@
+/*
+ * DiceConfigManager - Deep Sleep Example
+ * 
+ * This example keeps the validated configuration in RTC slow memory
+ * across deep sleep, so waking up does not mount LittleFS, scan the
+ * root directory or parse the config file.
+ * 
+ * - First boot (or after power loss): config is loaded from flash
+ * - Every wake: config is restored from RTC memory in microseconds
+ * 
+ * Hardware: ESP32 / ESP32-S3 with LittleFS support
+ */
+
+#include <DiceConfigManager.h>
+
+DiceConfigManager configManager;
+
+void setup() {
+  unsigned long start = micros();
+  
+  configManager.enableRtcCache();
+  configManager.begin();
+  
+  unsigned long elapsed = micros() - start;
+  
+  Serial.begin(115200);
+  Serial.printf("Config ready in %lu us (%s)\n", elapsed,
+                configManager.wasRestoredFromRtc() ? "RTC memory" : "flash");
+  Serial.printf("Dice ID: %s\n", configManager.getConfig().diceId);
+  
+  // ... roll the dice ...
+  delay(2000);
+  
+  // Stash the config right before sleeping
+  configManager.storeToRtc();
+  
+  Serial.println("Going to deep sleep for 10 s");
+  Serial.flush();
+  esp_sleep_enable_timer_wakeup(10ULL * 1000000ULL);
+  esp_deep_sleep_start();
+}
+
+void loop() {
+  // Never reached
+}
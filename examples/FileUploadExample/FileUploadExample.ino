@@ -42,6 +42,7 @@ void setup() {
     return;
   }
   
+  configManager.drainLog(Serial);
   Serial.println("Config manager initialized");
   Serial.println("Upload a new config.txt file and it will be automatically reloaded");
   Serial.println();
@@ -50,6 +51,9 @@ void setup() {
 }
 
 void loop() {
+  // Verbose messages are queued; print them outside time-critical code
+  configManager.drainLog(Serial);
+  
   // Periodically check if config file has been updated
   // In a real application, you might trigger this reload after
   // a file upload event from your web server
@@ -57,6 +61,13 @@ void loop() {
   if (millis() - lastCheck >= CHECK_INTERVAL) {
     lastCheck = millis();
     
+    // Cheap poll: only re-parses when the file actually changed
+    bool reloaded = false;
+    if (configManager.reloadIfChanged(&reloaded) && reloaded) {
+      Serial.println("\n--- Config file changed, reloaded ---");
+      configManager.printConfig();
+    }
+    
     // Check if user wants to reload config via Serial
     if (Serial.available()) {
       char cmd = Serial.read();
@@ -117,6 +128,10 @@ void onFileUploaded(const char* filename) {
   if (fname.endsWith("_config.txt") || fname.endsWith("config.txt")) {
     Serial.println("Config file uploaded, reloading...");
     
+    // LittleFS can't tell the cached auto-detection index that a file
+    // was added; without this a second config file would go unnoticed
+    configManager.invalidateConfigIndex();
+    
     // The library will auto-detect the new config file
     if (configManager.load()) {
       Serial.println("New configuration loaded successfully!");
@@ -0,0 +1,58 @@
+/*
+ * DiceConfigManager - Snapshot Example
+ * 
+ * This example demonstrates how to read the configuration safely from
+ * another task (e.g. an ESP-NOW receive task on the other core) while
+ * the main loop reloads the config file.
+ * 
+ * - getConfig() is the writer's working copy: use it from one task only
+ * - snapshot() returns a consistent copy of the last published config
+ *   and never blocks, so it can be called from any task or core
+ * 
+ * Hardware: dual-core ESP32 / ESP32-S3 with LittleFS support
+ */
+
+#include <DiceConfigManager.h>
+
+DiceConfigManager configManager;
+
+// Simulates a receive task that checks RSSI against the configured limit
+void receiveTask(void* param) {
+  uint32_t lastGeneration = 0;
+  
+  for (;;) {
+    DiceConfig config = configManager.snapshot();
+    
+    if (configManager.getGeneration() != lastGeneration) {
+      lastGeneration = configManager.getGeneration();
+      Serial.printf("[core %d] rssiLimit=%d peer A=%s\n",
+                    xPortGetCoreID(), config.rssiLimit,
+                    configManager.macToString(config.deviceA_mac).c_str());
+    }
+    
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  
+  Serial.println("\n=== DiceConfigManager Snapshot Example ===\n");
+  
+  configManager.begin();
+  
+  // Reader runs on core 0, the Arduino loop runs on core 1
+  xTaskCreatePinnedToCore(receiveTask, "receive", 4096, nullptr, 2, nullptr, 0);
+}
+
+void loop() {
+  // Writer side: reload and modify while the reader keeps running
+  configManager.reloadIfChanged();
+  
+  static int8_t limit = -70;
+  limit = (limit <= -80) ? -60 : limit - 1;
+  configManager.setRssiLimit(limit);
+  
+  delay(1000);
+}
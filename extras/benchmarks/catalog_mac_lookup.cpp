@@ -0,0 +1,110 @@
+/*
+ * catalog_mac_lookup - DiceConfigCatalog::findByMac() benchmark
+ *
+ * Fills a catalog with N dice (3 MACs each, sequential NIC bytes like a
+ * real fleet) and times findByMac() against a linear scan of the MAC
+ * column, for MACs that are present and MACs that are not.
+ *
+ * Build (from the library root):
+ *   g++ -std=gnu++11 -O2 -I. extras/benchmarks/catalog_mac_lookup.cpp \
+ *       DiceConfigCatalog.cpp DiceConfigParser.cpp DiceConfigStorage.cpp \
+ *       DiceConfigPattern.cpp DiceConfigPlatform.cpp DiceConfigIdIndex.cpp \
+ *       DiceConfigManifest.cpp -o catalog_mac_lookup
+ *
+ * Usage:
+ *   catalog_mac_lookup [entries (10000)] [lookups (1000000)]
+ */
+
+#include "DiceConfigCatalog.h"
+
+#include <chrono>
+
+static void macOf(uint32_t n, uint8_t* mac) {
+  mac[0] = 0x24;
+  mac[1] = 0x6F;
+  mac[2] = 0x28;
+  mac[3] = (uint8_t)(n >> 16);
+  mac[4] = (uint8_t)(n >> 8);
+  mac[5] = (uint8_t)n;
+}
+
+static int findLinear(const DiceConfigCatalog& catalog, const uint8_t* mac) {
+  const uint8_t (*macs)[3][6] = catalog.macs();
+  for (size_t i = 0; i < catalog.size(); i++) {
+    for (int r = 0; r < 3; r++) {
+      if (memcmp(macs[i][r], mac, 6) == 0) {
+        return (int)i;
+      }
+    }
+  }
+  return -1;
+}
+
+template <typename Find>
+static double nsPerLookup(Find find, const uint8_t (*macs)[6], size_t count, size_t lookups,
+                          long& checksum) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < lookups; i++) {
+    checksum += find(macs[i % count]);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / lookups;
+}
+
+int main(int argc, char** argv) {
+  size_t entries = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000;
+  size_t lookups = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1000000;
+
+  DiceConfigCatalog catalog;
+  if (entries == 0 || !catalog.begin(entries)) {
+    fprintf(stderr, "catalog: %s\n", catalog.getLastError());
+    return 1;
+  }
+
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < entries; i++) {
+    snprintf(config.diceId, sizeof(config.diceId), "D%05u", (unsigned)i);
+    macOf(3 * i + 1, config.deviceA_mac);
+    macOf(3 * i + 2, config.deviceB1_mac);
+    macOf(3 * i + 3, config.deviceB2_mac);
+    if (catalog.add(config) < 0) {
+      fprintf(stderr, "add: %s\n", catalog.getLastError());
+      return 1;
+    }
+  }
+  std::chrono::duration<double, std::milli> built = std::chrono::steady_clock::now() - start;
+
+  // Present and absent MACs, in a scrambled order
+  const size_t SAMPLES = 4096;
+  static uint8_t present[SAMPLES][6];
+  static uint8_t absent[SAMPLES][6];
+  uint32_t x = 12345;
+  for (size_t i = 0; i < SAMPLES; i++) {
+    x = x * 1103515245u + 12345u;
+    macOf((x >> 8) % (3 * (uint32_t)entries) + 1, present[i]);
+    macOf(3 * (uint32_t)entries + 1 + (x >> 8) % 100000, absent[i]);
+  }
+
+  // The linear scan gets fewer lookups; it is O(n)
+  size_t linearLookups = lookups / (entries / 100 + 1) + 1;
+  long checksum = 0;
+  struct Hashed {
+    const DiceConfigCatalog* catalog;
+    int operator()(const uint8_t* mac) const { return catalog->findByMac(mac); }
+  } hashed = { &catalog };
+  struct Linear {
+    const DiceConfigCatalog* catalog;
+    int operator()(const uint8_t* mac) const { return findLinear(*catalog, mac); }
+  } linear = { &catalog };
+
+  printf("%u entries, %u MACs, built in %.2f ms, %u bytes\n", (unsigned)entries,
+         (unsigned)(3 * entries), built.count(), (unsigned)catalog.memoryUsage());
+  printf("findByMac  hit  %8.1f ns\n", nsPerLookup(hashed, present, SAMPLES, lookups, checksum));
+  printf("findByMac  miss %8.1f ns\n", nsPerLookup(hashed, absent, SAMPLES, lookups, checksum));
+  printf("linear     hit  %8.1f ns\n", nsPerLookup(linear, present, SAMPLES, linearLookups, checksum));
+  printf("linear     miss %8.1f ns\n", nsPerLookup(linear, absent, SAMPLES, linearLookups, checksum));
+  printf("(checksum %ld)\n", checksum);
+  return 0;
+}
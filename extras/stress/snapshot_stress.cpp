@@ -0,0 +1,192 @@
+/*
+ * snapshot_stress - Concurrent readers against the seqlock snapshots
+ *
+ * Several reader threads call snapshot() in a tight loop while one writer
+ * keeps changing the config: batches of setters and getConfig() edits
+ * between beginUpdate() and commit() (now and then a nested batch or an
+ * abort()), and load() of files saved with their checksum. Every config
+ * the writer publishes carries a valid checksum, and the MAC bytes and
+ * colors are all derived from one counter, so a torn read shows up as a
+ * checksum mismatch or an inconsistent counter.
+ *
+ * Build (from the library root):
+ *   g++ -std=gnu++11 -O2 -pthread -I. extras/stress/snapshot_stress.cpp \
+ *       DiceConfig*.cpp -o snapshot_stress
+ *
+ * Usage:
+ *   snapshot_stress [seconds (5)] [readers (cores - 1, at least 2)]
+ *
+ * Exit status is 0 if every snapshot was consistent, 1 otherwise.
+ */
+
+#include "DiceConfigManager.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct ReaderStats {
+  uint64_t reads;
+  uint64_t torn;
+  uint64_t changes;
+};
+
+// Fields the writer derives from counter
+static void stamp(DiceConfig& config, uint32_t counter) {
+  for (int i = 0; i < 6; i++) {
+    config.deviceA_mac[i] = (uint8_t)(counter >> (i % 4 * 8));
+  }
+  config.x_background = (uint16_t)counter;
+  config.y_background = (uint16_t)~counter;
+  config.z_background = (uint16_t)(counter >> 16);
+  config.deepSleepTimeout = counter;
+}
+
+static bool consistent(const DiceConfig& config) {
+  uint32_t counter = config.deepSleepTimeout;
+  DiceConfig expected = config;
+  stamp(expected, counter);
+  return config.checksum == DiceConfigParser::checksum(config) &&
+         memcmp(&expected, &config, sizeof(config)) == 0;
+}
+
+static void runReader(const DiceConfigManager* manager, const std::atomic<bool>* stop,
+                      ReaderStats* stats) {
+  uint32_t last = 0;
+  while (!stop->load(std::memory_order_relaxed)) {
+    DiceConfig config = manager->snapshot();
+    stats->reads++;
+    if (!consistent(config)) {
+      if (stats->torn++ < 5) {
+        fprintf(stderr, "torn snapshot: counter %u, checksum %u, expected %u\n",
+                (unsigned)config.deepSleepTimeout, config.checksum,
+                DiceConfigParser::checksum(config));
+      }
+    }
+    if (config.deepSleepTimeout != last) {
+      last = config.deepSleepTimeout;
+      stats->changes++;
+    }
+  }
+}
+
+// Saves a config stamped with counter to path
+static bool saveStamped(DiceConfigManager& manager, const char* path, uint32_t counter) {
+  manager.beginUpdate();
+  stamp(manager.getConfig(), counter);
+  if (!manager.commit(false)) {
+    return false;
+  }
+  return manager.save(path);
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 5;
+  unsigned readers = argc > 2 ? (unsigned)atoi(argv[2]) : std::thread::hardware_concurrency() - 1;
+  if (readers < 2) {
+    readers = 2;
+  }
+
+  char dir[] = "/tmp/dice_snapshot_stressXXXXXX";
+  if (mkdtemp(dir) == nullptr) {
+    fprintf(stderr, "cannot create a temp directory\n");
+    return 1;
+  }
+
+  DiceConfigManager manager;
+  manager.getStorage().setRoot(dir);
+
+  // Two files for the writer to alternate between, then a clean start
+  const char* files[2] = { "/A_config.txt", "/B_config.txt" };
+  uint32_t fileCounters[2] = { 0xA0A0A0A0UL, 0x0B0B0B0BUL };
+  for (int i = 0; i < 2; i++) {
+    if (!saveStamped(manager, files[i], fileCounters[i])) {
+      fprintf(stderr, "%s: %s\n", files[i], manager.getLastError());
+      return 1;
+    }
+  }
+  if (!saveStamped(manager, "/start.txt", 1)) {
+    fprintf(stderr, "start: %s\n", manager.getLastError());
+    return 1;
+  }
+
+  std::atomic<bool> stop(false);
+  std::vector<ReaderStats> stats(readers);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < readers; i++) {
+    stats[i].reads = 0;
+    stats[i].torn = 0;
+    stats[i].changes = 0;
+    threads.push_back(std::thread(runReader, &manager, &stop, &stats[i]));
+  }
+
+  uint64_t commits = 0;
+  uint64_t aborts = 0;
+  uint64_t loads = 0;
+  bool writerOk = true;
+  Clock::time_point end =
+      Clock::now() + std::chrono::microseconds((long long)(seconds * 1e6));
+  for (uint32_t counter = 2; writerOk && Clock::now() < end; counter++) {
+    if (counter % 64 == 0) {
+      // A whole file replaces the config in one publish
+      const char* path = files[(counter / 64) % 2];
+      writerOk = manager.load(path);
+      loads++;
+      continue;
+    }
+
+    manager.beginUpdate();
+    uint8_t mac[6];
+    memcpy(mac, manager.getConfig().deviceA_mac, 6);
+    mac[0] ^= 0xFF;
+    manager.setDeviceAMac(mac);   // Inconsistent until the batch is done
+    stamp(manager.getConfig(), counter);
+    if (counter % 16 == 3) {
+      // Nested batch, folded into the outer one
+      manager.beginUpdate();
+      manager.getConfig().x_background ^= 0x5555;
+      manager.getConfig().x_background ^= 0x5555;
+      writerOk = manager.commit(false);
+    }
+    if (counter % 16 == 7) {
+      manager.abort();
+      aborts++;
+    } else {
+      writerOk = writerOk && manager.commit(false);
+      commits++;
+    }
+  }
+  if (!writerOk) {
+    fprintf(stderr, "writer: %s\n", manager.getLastError());
+  }
+
+  stop.store(true);
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint64_t changes = 0;
+  for (unsigned i = 0; i < readers; i++) {
+    threads[i].join();
+    reads += stats[i].reads;
+    torn += stats[i].torn;
+    changes += stats[i].changes;
+  }
+
+  std::string root(dir);
+  for (int i = 0; i < 2; i++) {
+    unlink((root + files[i]).c_str());
+  }
+  unlink((root + "/start.txt").c_str());
+  rmdir(dir);
+
+  printf("%u readers, %.1f s: %llu snapshots, %llu saw a change, %llu torn\n", readers, seconds,
+         (unsigned long long)reads, (unsigned long long)changes, (unsigned long long)torn);
+  printf("writer: %llu commits, %llu aborts, %llu loads\n", (unsigned long long)commits,
+         (unsigned long long)aborts, (unsigned long long)loads);
+  return writerOk && torn == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/*
+ * dice_config_compile - Compile a *_config.txt into a constexpr DiceConfig
+ * 
+ * The file is parsed and validated with the library's own parser
+ * (DiceConfigParser), starting from the library defaults exactly like
+ * DiceConfigManager::load() does. The generated header can be passed to
+ * DiceConfigManager::setBaseConfig(), so firmware starts without any
+ * parsing or filesystem access.
+ * 
+ * Build (from the library root):
+ *   g++ -std=gnu++11 -O2 -I. extras/tools/dice_config_compile.cpp \
+ *       DiceConfigParser.cpp DiceConfigStorage.cpp DiceConfigPlatform.cpp \
+ *       -o dice_config_compile
+ * 
+ * Usage:
+ *   dice_config_compile TEST1_config.txt [-o TEST1_config.h] [-n NAME]
+ * 
+ * Exit status is 0 on success, 1 if the file is malformed or invalid.
+ */
+
+#include "DiceConfigParser.h"
+#include "DiceConfigStorage.h"
+
+static void usage() {
+  fprintf(stderr, "usage: dice_config_compile <config.txt> [-o <header.h>] [-n <name>]\n");
+}
+
+// Parse path with the same line framing as the library; returns the
+// number of problems found (reported on stderr)
+static int parseConfigFile(const char* path, DiceConfig& config) {
+  // Storage paths are relative to a root: split into directory + name
+  char dir[192];
+  const char* slash = strrchr(path, '/');
+  const char* name = slash ? slash + 1 : path;
+  if (slash) {
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+  } else {
+    strcpy(dir, ".");
+  }
+  
+  DicePosixStorage storage;
+  storage.setRoot(dir[0] ? dir : "/");
+  DicePosixStorage::File file;
+  if (!storage.mount(false) || !storage.open(file, name, "r")) {
+    fprintf(stderr, "%s: cannot open file\n", path);
+    return 1;
+  }
+  
+  DiceLineReader reader(file);
+  char line[128];
+  int len;
+  int lineNum = 0;
+  int problems = 0;
+  
+  while ((len = reader.readLine(line, sizeof(line))) >= 0) {
+    lineNum++;
+    char* key = nullptr;
+    switch (DiceConfigParser::parseLine(line, config, &key)) {
+      case DICE_PARSE_NO_SEPARATOR:
+        fprintf(stderr, "%s:%d: invalid format (no '=')\n", path, lineNum);
+        problems++;
+        break;
+      case DICE_PARSE_BAD_MAC:
+        fprintf(stderr, "%s:%d: invalid MAC address format\n", path, lineNum);
+        problems++;
+        break;
+      case DICE_PARSE_UNKNOWN_KEY:
+        fprintf(stderr, "%s:%d: unknown key '%s'\n", path, lineNum, key);
+        problems++;
+        break;
+      case DICE_PARSE_SIGNATURE:
+        fprintf(stderr, "%s:%d: note: signature ignored (embedded configs are not signed)\n",
+                path, lineNum);
+        break;
+      default:
+        break;
+    }
+  }
+  
+  return problems;
+}
+
+static void printMac(FILE* out, const uint8_t* mac) {
+  fprintf(out, "{ 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X }",
+          mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static void writeHeader(FILE* out, const DiceConfig& c, const char* source, const char* name) {
+  const char* base = strrchr(source, '/');
+  base = base ? base + 1 : source;
+  
+  fprintf(out, "// Generated by dice_config_compile from %s - do not edit\n", base);
+  fprintf(out, "#ifndef %s_H\n#define %s_H\n\n", name, name);
+  fprintf(out, "#include <DiceConfigManager.h>\n\n");
+  fprintf(out, "#define %s_CHECKSUM 0x%02Xu\n\n", name, c.checksum);
+  fprintf(out, "static constexpr DiceConfig %s = {\n", name);
+  fprintf(out, "  \"%s\",\n", c.diceId);
+  fprintf(out, "  ");
+  printMac(out, c.deviceA_mac);
+  fprintf(out, ",\n  ");
+  printMac(out, c.deviceB1_mac);
+  fprintf(out, ",\n  ");
+  printMac(out, c.deviceB2_mac);
+  fprintf(out, ",\n");
+  fprintf(out, "  0x%04X, 0x%04X, 0x%04X,  // x/y/z background\n",
+          c.x_background, c.y_background, c.z_background);
+  fprintf(out, "  0x%04X, 0x%04X,  // entanglement colors\n",
+          c.entang_ab1_color, c.entang_ab2_color);
+  fprintf(out, "  %d,  // rssiLimit\n", c.rssiLimit);
+  fprintf(out, "  %s, %s, %s,  // isSMD, isNano, alwaysSeven\n",
+          c.isSMD ? "true" : "false", c.isNano ? "true" : "false",
+          c.alwaysSeven ? "true" : "false");
+  fprintf(out, "  %u,  // randomSwitchPoint\n", c.randomSwitchPoint);
+  // %.9g round-trips every float exactly
+  fprintf(out, "  %.9gf,  // tumbleConstant\n", (double)c.tumbleConstant);
+  fprintf(out, "  %luu,  // deepSleepTimeout\n", (unsigned long)c.deepSleepTimeout);
+  fprintf(out, "  %s_CHECKSUM\n", name);
+  fprintf(out, "};\n\n#endif // %s_H\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* input = nullptr;
+  const char* output = nullptr;
+  const char* name = "DICE_EMBEDDED_CONFIG";
+  
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      name = argv[++i];
+    } else if (argv[i][0] != '-' && input == nullptr) {
+      input = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (input == nullptr) {
+    usage();
+    return 1;
+  }
+  
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+  if (parseConfigFile(input, config) != 0) {
+    return 1;
+  }
+  
+  // A checksum in the file must match what was parsed, as in load()
+  if (config.checksum != 0 && config.checksum != DiceConfigParser::checksum(config)) {
+    fprintf(stderr, "%s: checksum mismatch (file says %u, content gives %u)\n",
+            input, config.checksum, DiceConfigParser::checksum(config));
+    return 1;
+  }
+  config.checksum = DiceConfigParser::checksum(config);
+  
+  uint32_t errors = DiceConfigParser::validate(config);
+  if (errors & DICE_INVALID_ID) {
+    fprintf(stderr, "%s: diceId is empty\n", input);
+  }
+  if (errors & DICE_INVALID_SWITCH_POINT) {
+    fprintf(stderr, "%s: randomSwitchPoint > 100\n", input);
+  }
+  if (errors & DICE_INVALID_TUMBLE) {
+    fprintf(stderr, "%s: tumbleConstant <= 0\n", input);
+  }
+  if (errors != 0) {
+    return 1;
+  }
+  
+  FILE* out = stdout;
+  if (output != nullptr) {
+    out = fopen(output, "w");
+    if (out == nullptr) {
+      fprintf(stderr, "%s: cannot write\n", output);
+      return 1;
+    }
+  }
+  writeHeader(out, config, input, name);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * dice_config_macindex - Build the MAC index for a fleet filesystem image
+ *
+ * Walks a directory tree (the future LittleFS root) with the same
+ * DicePatternSet::walk() as DiceConfigManager, parses every file
+ * matching the discovery patterns and writes the sorted DiceMacIndex. With the index in the
+ * image, each device of the fleet finds its own config by MAC with a
+ * binary search instead of parsing files at boot.
+ *
+ * The index records which files it was built from (names and sizes).
+ * A device whose files differ rebuilds it on its own, so keep -p in line
+ * with setConfigPatterns() (and DICE_CONFIG_WALK_DEPTH with the firmware).
+ *
+ * Build (from the library root):
+ *   g++ -std=gnu++11 -O2 -I. extras/tools/dice_config_macindex.cpp \
+ *       DiceConfigMacIndex.cpp DiceConfigPattern.cpp DiceConfigParser.cpp \
+ *       DiceConfigStorage.cpp DiceConfigPlatform.cpp -o dice_config_macindex
+ *
+ * Usage:
+ *   dice_config_macindex <root> [-p "*_config.txt"] [-o /.dcm_macidx]
+ *
+ * Exit status is 0 on success, 1 on errors or duplicate MACs.
+ */
+
+#include "DiceConfigMacIndex.h"
+#include "DiceConfigPattern.h"
+
+#include <vector>
+
+struct Walk {
+  DicePosixStorage storage;
+  DicePatternSet patterns;
+  std::vector<DiceMacIndexRecord> records;
+  uint32_t sourceHash;
+  int files;
+  int problems;
+};
+
+static void usage() {
+  fprintf(stderr, "usage: dice_config_macindex <root> [-p <patterns>] [-o <index>]\n");
+}
+
+static void addFile(Walk& walk, const char* path, uint32_t size) {
+  walk.sourceHash += DiceMacIndex::fileHash(path, size);
+  walk.files++;
+
+  char fullPath[160];
+  snprintf(fullPath, sizeof(fullPath), "/%s", path);
+  DicePosixStorage::File file;
+  if (!walk.storage.open(file, fullPath, "r")) {
+    fprintf(stderr, "%s: cannot open file\n", path);
+    walk.problems++;
+    return;
+  }
+
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+  DiceLineReader reader(file);
+  char line[128];
+  while (reader.readLine(line, sizeof(line)) >= 0) {
+    DiceConfigParser::parseLine(line, config);
+  }
+  file.close();
+
+  DiceMacIndexRecord records[3];
+  size_t count;
+  if (!DiceMacIndex::recordsFor(path, config, records, count)) {
+    fprintf(stderr, "%s: path too long for the index (max %u)\n", path,
+            (unsigned)sizeof(records[0].path) - 1);
+    walk.problems++;
+  }
+  walk.records.insert(walk.records.end(), records, records + count);
+}
+
+static void visitFile(const char* path, int priority, const DiceFileInfo& info, void* context) {
+  (void)priority;
+  addFile(*(Walk*)context, path, info.size);
+}
+
+int main(int argc, char** argv) {
+  const char* root = nullptr;
+  const char* patterns = DICE_CONFIG_PATTERNS;
+  const char* output = DICE_CONFIG_MACIDX_PATH;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      patterns = argv[++i];
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (argv[i][0] != '-' && root == nullptr) {
+      root = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (root == nullptr) {
+    usage();
+    return 1;
+  }
+
+  Walk walk;
+  walk.sourceHash = 0;
+  walk.files = 0;
+  walk.problems = 0;
+  if (!walk.patterns.compile(patterns)) {
+    fprintf(stderr, "invalid pattern list: %s\n", patterns);
+    return 1;
+  }
+  walk.storage.setRoot(root);
+  if (!walk.storage.mount(false)) {
+    fprintf(stderr, "%s: cannot open root\n", root);
+    return 1;
+  }
+
+  if (!walk.patterns.walk(walk.storage, visitFile, &walk)) {
+    fprintf(stderr, "%s: cannot open root\n", root);
+    return 1;
+  }
+
+  if (!DiceMacIndex::write(walk.storage, output, walk.records.empty() ? nullptr : &walk.records[0],
+                           walk.records.size(), walk.sourceHash)) {
+    fprintf(stderr, "%s: cannot write index\n", output);
+    return 1;
+  }
+
+  // write() sorted the records: MACs claimed by more than one file are
+  // adjacent. The device refuses those.
+  for (size_t i = 1; i < walk.records.size(); i++) {
+    const DiceMacIndexRecord& a = walk.records[i - 1];
+    const DiceMacIndexRecord& b = walk.records[i];
+    if (memcmp(a.mac, b.mac, sizeof(a.mac)) == 0 && strcmp(a.path, b.path) != 0) {
+      fprintf(stderr, "%02X:%02X:%02X:%02X:%02X:%02X in both %s and %s\n",
+              a.mac[0], a.mac[1], a.mac[2], a.mac[3], a.mac[4], a.mac[5], a.path, b.path);
+      walk.problems++;
+    }
+  }
+
+  printf("%s: %d files, %u MACs\n", output, walk.files, (unsigned)walk.records.size());
+  return walk.problems == 0 ? 0 : 1;
+}
@@ -0,0 +1,424 @@
+/*
+ * dice_config_manifest_scan - Parse a large fleet manifest on the host
+ *
+ * Loads a manifest with DiceManifestScan (mmap, SIMD line scanning,
+ * chunks parsed in parallel) and reports sections and throughput.
+ *
+ *   --diff      Also parse it with DiceManifest::forEach(), the line
+ *               reader path the firmware uses, and compare: same sections
+ *               in the same order, byte-identical configs, offsets and
+ *               header lengths that DiceManifest::checkHeader() accepts.
+ *               Every code path the CPU has is checked, on one thread and
+ *               on -j threads. Prints both timings.
+ *   --fuzz N    Differential test on N random manifests (long lines, CRs,
+ *               NULs, comments, odd headers), cut into tiny chunks so
+ *               every boundary case is hit. Also checks the records of
+ *               DiceManifest::buildIndex(). Files go to a temp directory.
+ *   --generate  Write a synthetic fleet manifest of N sections to the
+ *               given path, for benchmarking.
+ *
+ * Build (from the library root):
+ *   g++ -std=gnu++11 -O2 -pthread -I. extras/tools/dice_config_manifest_scan.cpp \
+ *       DiceConfigManifestScan.cpp DiceConfigManifest.cpp DiceConfigParser.cpp \
+ *       DiceConfigStorage.cpp DiceConfigPlatform.cpp -o dice_config_manifest_scan
+ *
+ * Usage:
+ *   dice_config_manifest_scan [-j threads] [--isa scalar|sse2|avx2] [--diff] <manifest>
+ *   dice_config_manifest_scan --fuzz <count> [--seed <n>]
+ *   dice_config_manifest_scan --generate <sections> <manifest>
+ *
+ * Exit status is 0 on success, 1 on errors or differences, 2 on usage
+ * errors.
+ */
+
+#include "DiceConfigManifestScan.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Reference {
+  std::string name;
+  DiceConfig config;
+};
+
+static void usage() {
+  fprintf(stderr, "usage: dice_config_manifest_scan [-j <threads>] [--isa scalar|sse2|avx2] "
+                  "[--diff] <manifest>\n"
+                  "       dice_config_manifest_scan --fuzz <count> [--seed <n>]\n"
+                  "       dice_config_manifest_scan --generate <sections> <manifest>\n");
+}
+
+static double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void collectReference(const char* name, const DiceConfig& config, void* context) {
+  std::vector<Reference>& sections = *(std::vector<Reference>*)context;
+  Reference reference;
+  reference.name = name;
+  reference.config = config;
+  sections.push_back(reference);
+}
+
+// Storage rooted at the manifest's directory; path becomes "/<base name>"
+static bool openStorage(const char* manifestPath, DicePosixStorage& storage, std::string& path) {
+  std::string full(manifestPath);
+  size_t slash = full.rfind('/');
+  std::string root = slash == std::string::npos ? "." : (slash == 0 ? "/" : full.substr(0, slash));
+  path = "/" + (slash == std::string::npos ? full : full.substr(slash + 1));
+  storage.setRoot(root.c_str());
+  return storage.mount(false);
+}
+
+// Compare a scan with the reference parse of the same file. Returns the
+// number of differences, printing the first few.
+static int compareScan(const DiceManifestScan& scan, const std::vector<Reference>& reference,
+                       DicePosixStorage& storage, const std::string& path, size_t manifestSize,
+                       time_t manifestWrite, bool checkIndex, const char* label) {
+  int problems = 0;
+  if (scan.size() != reference.size()) {
+    fprintf(stderr, "%s: %u sections, reference has %u\n", label, (unsigned)scan.size(),
+            (unsigned)reference.size());
+    problems++;
+  }
+
+  size_t count = scan.size() < reference.size() ? scan.size() : reference.size();
+  for (size_t i = 0; i < count && problems < 5; i++) {
+    if (reference[i].name != scan.section(i).name) {
+      fprintf(stderr, "%s: section %u is '%s', reference has '%s'\n", label, (unsigned)i,
+              scan.section(i).name, reference[i].name.c_str());
+      problems++;
+    } else if (memcmp(&reference[i].config, &scan.config(i), sizeof(DiceConfig)) != 0) {
+      fprintf(stderr, "%s: section %u ('%s') config differs\n", label, (unsigned)i,
+              scan.section(i).name);
+      problems++;
+    }
+  }
+
+  DicePosixStorage::File file;
+  if (!storage.open(file, path.c_str(), "r")) {
+    fprintf(stderr, "%s: cannot reopen the manifest\n", label);
+    return problems + 1;
+  }
+
+  // Sections tile the file from the first one to the end, except for
+  // the skipped lines after a header with a bad name
+  for (size_t i = 0; i < scan.size() && problems < 5; i++) {
+    const DiceManifestSection& section = scan.section(i);
+    size_t stop = (size_t)section.offset + section.length;
+    size_t end = i + 1 < scan.size() ? scan.section(i + 1).offset : manifestSize;
+    bool tiled = stop == end;
+    if (stop < end && file.seek(stop)) {
+      DiceLineReader reader(file);
+      char line[128];
+      char name[sizeof(section.name)];
+      tiled = reader.readLine(line, sizeof(line)) >= 0 && DiceManifest::isHeader(line) &&
+              !DiceManifest::parseHeader(line, name, sizeof(name));
+    }
+    if (!tiled) {
+      fprintf(stderr, "%s: section %u ('%s') ends at %u, next starts at %u\n", label,
+              (unsigned)i, section.name, (unsigned)stop, (unsigned)end);
+      problems++;
+    }
+  }
+
+  // Offsets and header lengths as the firmware checks them
+  for (size_t i = 0; i < scan.size() && problems < 5; i++) {
+    const DiceManifestSection& section = scan.section(i);
+    if (!file.seek(section.offset) || !DiceManifest::checkHeader(file, section)) {
+      fprintf(stderr, "%s: section %u ('%s') has no matching header at %u\n", label,
+              (unsigned)i, section.name, (unsigned)section.offset);
+      problems++;
+    }
+  }
+  file.close();
+
+  // The first section of each name against the index records
+  for (size_t i = 0; checkIndex && i < scan.size() && problems < 5; i++) {
+    const DiceManifestSection& section = scan.section(i);
+    bool first = section.name[0] != '\0';
+    for (size_t j = 0; first && j < i; j++) {
+      first = strcmp(scan.section(j).name, section.name) != 0;
+    }
+    DiceManifestSection indexed;
+    if (first && (DiceManifest::find(storage, path.c_str(), manifestSize, manifestWrite,
+                                     section.name, indexed) != DiceManifest::FOUND ||
+                  memcmp(&indexed, &section, sizeof(section)) != 0)) {
+      fprintf(stderr, "%s: section %u ('%s') differs from its index record\n", label,
+              (unsigned)i, section.name);
+      problems++;
+    }
+  }
+  return problems;
+}
+
+// Scan manifestPath on every code path, on one thread and on threads
+static int diffManifest(const char* manifestPath, unsigned threads, size_t chunkSize,
+                        bool checkIndex, bool verbose) {
+  DicePosixStorage storage;
+  std::string path;
+  if (!openStorage(manifestPath, storage, path)) {
+    fprintf(stderr, "%s: cannot open directory\n", manifestPath);
+    return 1;
+  }
+  DicePosixStorage::File file;
+  if (!storage.open(file, path.c_str(), "r")) {
+    fprintf(stderr, "%s: cannot open file\n", manifestPath);
+    return 1;
+  }
+  size_t manifestSize = file.size();
+  time_t manifestWrite = file.lastWrite();
+  file.close();
+
+  std::vector<Reference> reference;
+  Clock::time_point start = Clock::now();
+  DiceManifest::forEach(storage, path.c_str(), collectReference, &reference);
+  double referenceMillis = millisSince(start);
+  if (verbose) {
+    printf("line reader:  %u sections in %.1f ms (%.1f MB/s)\n", (unsigned)reference.size(),
+           referenceMillis, manifestSize / referenceMillis / 1000);
+  }
+  if (checkIndex && !DiceManifest::buildIndex(storage, path.c_str())) {
+    fprintf(stderr, "%s: cannot build the index\n", manifestPath);
+    return 1;
+  }
+
+  int problems = 0;
+  unsigned threadCounts[2] = { 1, threads };
+  for (int isa = DICE_SCAN_SCALAR; isa <= DiceManifestScan::bestIsa(); isa++) {
+    for (int t = 0; t < (threads > 1 ? 2 : 1); t++) {
+      DiceManifestScan scan;
+      scan.setIsa((DiceScanIsa)isa);
+      scan.setChunkSize(chunkSize);
+      char label[96];
+      snprintf(label, sizeof(label), "%s [%s, %u threads]", manifestPath,
+               DiceManifestScan::isaName((DiceScanIsa)isa), threadCounts[t]);
+
+      start = Clock::now();
+      if (!scan.load(manifestPath, threadCounts[t])) {
+        fprintf(stderr, "%s: %s\n", label, scan.getLastError());
+        problems++;
+        continue;
+      }
+      double millis = millisSince(start);
+      if (verbose) {
+        printf("%-6s x %2u:  %u sections in %.1f ms (%.1f MB/s, %.1fx)\n",
+               DiceManifestScan::isaName((DiceScanIsa)isa), threadCounts[t],
+               (unsigned)scan.size(), millis, manifestSize / millis / 1000,
+               referenceMillis / millis);
+      }
+      problems += compareScan(scan, reference, storage, path, manifestSize, manifestWrite,
+                              checkIndex, label);
+    }
+  }
+  return problems;
+}
+
+// Building blocks of a random manifest: plausible lines, broken ones
+// and the cases the line reader treats specially
+static std::string randomLine(std::mt19937& rng) {
+  static const char* const names[] = { "BART1", "TEST1", "D0001", "D0002", "Q" };
+  static const char* const lines[] = {
+    "deviceA_mac=24:6F:28:00:00:01", "deviceB1_mac = 24:6f:28:00:00:02 ",
+    "deviceB2_mac=24:6F:28:00:00", "rssiLimit=-70", "rssiLimit=", "tumbleConstant=3.5",
+    "tumbleConstant=1.00000000000000000000001", "tumbleConstant=1e400", "isSMD=true",
+    "isNano=1", "alwaysSeven=TRUE", "randomSwitchPoint=150", "x_background=0x1F",
+    "entang_ab1_color=65535", "deepSleepTimeout=300000", "diceId=", "diceId=OVERRIDE",
+    "diceId=AVERYLONGDICEIDENTIFIER", "unknownKey=1", "no separator", "signature=00ff",
+    "# comment", "   #rssiLimit=-10", "#", "", "   ", "\t", "=", "==", "[", "[]", "[ ]",
+    "[a]x", "[a=b]", "[0123456789ABCDEF]", "[0123456789ABCDE]", "  [ Q ]  ", "\t[Q]\t",
+  };
+  std::string line;
+  switch (rng() % 8) {
+    case 0:
+      line = std::string("[") + names[rng() % 5] + "]";
+      break;
+    case 1: {
+      // Long: pieces of 127, something interesting at or before the cut
+      std::string filler(100 + rng() % 60, "ab= #\t"[rng() % 6]);
+      std::string text = rng() % 3 ? lines[rng() % (sizeof(lines) / sizeof(lines[0]))] :
+                                     std::string("[") + names[rng() % 5] + "]";
+      switch (rng() % 3) {
+        case 0:
+          line = filler + text;
+          break;
+        case 1:
+          line = text + filler + "x";
+          break;
+        default:
+          // A header only when read whole
+          line = "[" + std::string(filler.size(), ' ') + names[rng() % 5] + "]";
+          break;
+      }
+      if (rng() % 2) {
+        line.resize(127 * (1 + rng() % 2));
+      }
+      break;
+    }
+    default:
+      line = lines[rng() % (sizeof(lines) / sizeof(lines[0]))];
+      break;
+  }
+  if (rng() % 10 == 0) {
+    line += '\r';
+  }
+  if (rng() % 40 == 0) {
+    line.insert(rng() % (line.size() + 1), 1, '\0');
+  }
+  return line;
+}
+
+static int fuzz(unsigned count, unsigned seed) {
+  char dir[] = "/tmp/dice_manifest_scanXXXXXX";
+  if (mkdtemp(dir) == nullptr) {
+    fprintf(stderr, "cannot create a temp directory\n");
+    return 1;
+  }
+  std::string path = std::string(dir) + "/fleet.txt";
+  std::mt19937 rng(seed);
+  int failures = 0;
+
+  for (unsigned i = 0; i < count; i++) {
+    std::string text;
+    size_t lines = rng() % 200;
+    for (size_t l = 0; l < lines; l++) {
+      text += randomLine(rng);
+      if (l + 1 < lines || rng() % 2) {
+        text += '\n';
+      }
+    }
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == nullptr || fwrite(text.data(), 1, text.size(), out) != text.size()) {
+      fprintf(stderr, "cannot write %s\n", path.c_str());
+      return 1;
+    }
+    fclose(out);
+
+    if (diffManifest(path.c_str(), 3, 1 + rng() % 256, true, false) != 0) {
+      std::string kept = std::string(dir) + "/failed_" + std::to_string(i) + ".txt";
+      rename(path.c_str(), kept.c_str());
+      fprintf(stderr, "case %u kept as %s\n", i, kept.c_str());
+      failures++;
+    }
+  }
+
+  std::string index = path + DICE_CONFIG_MANIFEST_INDEX_SUFFIX;
+  unlink(path.c_str());
+  unlink(index.c_str());
+  if (failures == 0) {
+    rmdir(dir);
+  }
+  printf("%u manifests, %d differ (seed %u)\n", count, failures, seed);
+  return failures == 0 ? 0 : 1;
+}
+
+static int generate(unsigned sections, const char* manifestPath) {
+  FILE* out = fopen(manifestPath, "w");
+  if (out == nullptr) {
+    fprintf(stderr, "%s: cannot create file\n", manifestPath);
+    return 1;
+  }
+  for (unsigned i = 0; i < sections; i++) {
+    fprintf(out, "[D%06u]\n", i);
+    fprintf(out, "# generated\n");
+    for (int role = 0; role < 3; role++) {
+      fprintf(out, "%s=24:6F:28:%02X:%02X:%02X\n",
+              role == 0 ? "deviceA_mac" : (role == 1 ? "deviceB1_mac" : "deviceB2_mac"),
+              (i >> 14) & 0xFF, (i >> 6) & 0xFF, ((i << 2) | role) & 0xFF);
+    }
+    fprintf(out, "x_background=%u\ny_background=%u\nz_background=%u\n", i & 0xFFFF,
+            (i * 7) & 0xFFFF, (i * 13) & 0xFFFF);
+    fprintf(out, "rssiLimit=-%u\ntumbleConstant=%u.5\nisSMD=%s\nisNano=%s\n", 50 + i % 40,
+            1 + i % 5, i % 2 ? "true" : "false", i % 3 ? "true" : "false");
+    fprintf(out, "randomSwitchPoint=%u\ndeepSleepTimeout=%u\n\n", i % 101, 60000 + i);
+  }
+  bool ok = ferror(out) == 0;
+  ok = fclose(out) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "%s: write failed\n", manifestPath);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  const char* isaName = nullptr;
+  bool diff = false;
+  long fuzzCount = -1;
+  unsigned seed = 1;
+  long generateCount = -1;
+  const char* manifestPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+      isaName = argv[++i];
+    } else if (strcmp(argv[i], "--diff") == 0) {
+      diff = true;
+    } else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+      fuzzCount = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = (unsigned)strtoul(argv[++i], nullptr, 0);
+    } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      generateCount = atol(argv[++i]);
+    } else if (argv[i][0] != '-' && manifestPath == nullptr) {
+      manifestPath = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  if (fuzzCount >= 0) {
+    return fuzz((unsigned)fuzzCount, seed);
+  }
+  if (manifestPath == nullptr) {
+    usage();
+    return 2;
+  }
+  if (generateCount >= 0) {
+    return generate((unsigned)generateCount, manifestPath);
+  }
+  if (diff) {
+    int problems = diffManifest(manifestPath, threads, DICE_CONFIG_SCAN_CHUNK, false, true);
+    printf("%s\n", problems == 0 ? "identical" : "DIFFERENT");
+    return problems == 0 ? 0 : 1;
+  }
+
+  DiceManifestScan scan;
+  if (isaName) {
+    int isa = DICE_SCAN_SCALAR;
+    while (isa <= DICE_SCAN_AVX2 && strcmp(isaName, DiceManifestScan::isaName((DiceScanIsa)isa)) != 0) {
+      isa++;
+    }
+    if (isa > DICE_SCAN_AVX2 || !scan.setIsa((DiceScanIsa)isa)) {
+      fprintf(stderr, "%s not available, best is %s\n", isaName,
+              DiceManifestScan::isaName(DiceManifestScan::bestIsa()));
+      return 2;
+    }
+  }
+
+  Clock::time_point start = Clock::now();
+  if (!scan.load(manifestPath, threads)) {
+    fprintf(stderr, "%s: %s\n", manifestPath, scan.getLastError());
+    return 1;
+  }
+  double millis = millisSince(start);
+  size_t bytes = scan.size() > 0 ? scan.section(scan.size() - 1).offset +
+                                   scan.section(scan.size() - 1).length : 0;
+  printf("%u sections in %.1f ms (%.1f MB/s) on %u threads, %s\n", (unsigned)scan.size(),
+         millis, bytes / millis / 1000, threads, DiceManifestScan::isaName(scan.getIsa()));
+  return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * dice_config_validate - Validate many config files in parallel
+ *
+ * Checks every file with the library's own parser and rules, the same
+ * ones dice_config_compile applies: malformed lines, bad MACs and
+ * unknown keys, a checksum that doesn't match, and validate() (empty
+ * diceId, randomSwitchPoint > 100, tumbleConstant <= 0).
+ *
+ * Files are spread over a work-stealing pool, one thread per core by
+ * default. Each worker starts with a contiguous share of the files
+ * (neighbours in a directory stay on one core) and works through it from
+ * the back; a worker that runs dry steals from the front of another's
+ * share. Workers share nothing else, so throughput scales with cores
+ * until the disk is the limit.
+ *
+ * Build (from the library root):
+ *   g++ -std=gnu++11 -O2 -pthread -I. extras/tools/dice_config_validate.cpp \
+ *       DiceConfigParser.cpp DiceConfigStorage.cpp DiceConfigPattern.cpp \
+ *       DiceConfigPlatform.cpp -o dice_config_validate
+ *
+ * Usage:
+ *   dice_config_validate [-j threads] [-p "*_config.txt"] [-q] <file|dir>...
+ *
+ * Directories are walked like auto-detection does (DicePatternSet::walk(),
+ * -p patterns, up to DICE_CONFIG_WALK_DEPTH levels). Problems go to stderr
+ * as "path:line: message", in input order. The summary (counts and
+ * timings) goes to stdout unless -q. Exit status is 0 if every file is
+ * valid, 1 if any isn't, 2 on usage errors.
+ */
+
+#include "DiceConfigParser.h"
+#include "DiceConfigStorage.h"
+#include "DiceConfigPattern.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Task {
+  std::string root;           // Storage root (directory)
+  std::string name;           // Path below root
+  std::string display;        // As reported
+};
+
+struct Result {
+  std::string messages;
+  bool valid;
+  double micros;
+  size_t bytes;
+};
+
+// One worker's share. The owner pops from the back, thieves take from
+// the front, so both ends rarely meet on the same lock.
+class TaskQueue {
+public:
+  void push(size_t task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push_back(task);
+  }
+
+  bool pop(size_t& task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_tasks.empty()) {
+      return false;
+    }
+    task = _tasks.back();
+    _tasks.pop_back();
+    return true;
+  }
+
+  bool steal(size_t& task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_tasks.empty()) {
+      return false;
+    }
+    task = _tasks.front();
+    _tasks.pop_front();
+    return true;
+  }
+
+private:
+  std::mutex _mutex;
+  std::deque<size_t> _tasks;
+};
+
+struct WorkerStats {
+  size_t files;
+  size_t steals;
+  double busyMicros;
+};
+
+struct Pool {
+  const std::vector<Task>* tasks;
+  std::vector<Result>* results;
+  std::vector<TaskQueue>* queues;
+  std::vector<WorkerStats>* stats;
+};
+
+static void usage() {
+  fprintf(stderr, "usage: dice_config_validate [-j <threads>] [-p <patterns>] [-q] <file|dir>...\n");
+}
+
+static void report(std::string& messages, const char* format, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void report(std::string& messages, const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  messages += buffer;
+  messages += '\n';
+}
+
+// Parse and check one file; the rules of dice_config_compile
+static void validateFile(const Task& task, Result& result) {
+  const char* path = task.display.c_str();
+  result.valid = false;
+  result.bytes = 0;
+
+  DicePosixStorage storage;
+  storage.setRoot(task.root.c_str());
+  DicePosixStorage::File file;
+  if (!storage.mount(false) || !storage.open(file, task.name.c_str(), "r")) {
+    report(result.messages, "%s: cannot open file", path);
+    return;
+  }
+  result.bytes = file.size();
+
+  DiceConfig config;
+  DiceConfigParser::setDefaults(config);
+  DiceLineReader reader(file);
+  char line[128];
+  int lineNum = 0;
+  int problems = 0;
+  while (reader.readLine(line, sizeof(line)) >= 0) {
+    lineNum++;
+    char* key = nullptr;
+    switch (DiceConfigParser::parseLine(line, config, &key)) {
+      case DICE_PARSE_NO_SEPARATOR:
+        report(result.messages, "%s:%d: invalid format (no '=')", path, lineNum);
+        problems++;
+        break;
+      case DICE_PARSE_BAD_MAC:
+        report(result.messages, "%s:%d: invalid MAC address format", path, lineNum);
+        problems++;
+        break;
+      case DICE_PARSE_UNKNOWN_KEY:
+        report(result.messages, "%s:%d: unknown key '%s'", path, lineNum, key);
+        problems++;
+        break;
+      default:
+        break;
+    }
+  }
+  file.close();
+
+  uint8_t checksum = DiceConfigParser::checksum(config);
+  if (config.checksum != 0 && config.checksum != checksum) {
+    report(result.messages, "%s: checksum mismatch (file says %u, content gives %u)",
+           path, config.checksum, checksum);
+    problems++;
+  }
+  config.checksum = checksum;
+
+  uint32_t errors = DiceConfigParser::validate(config);
+  if (errors & DICE_INVALID_ID) {
+    report(result.messages, "%s: diceId is empty", path);
+  }
+  if (errors & DICE_INVALID_SWITCH_POINT) {
+    report(result.messages, "%s: randomSwitchPoint > 100", path);
+  }
+  if (errors & DICE_INVALID_TUMBLE) {
+    report(result.messages, "%s: tumbleConstant <= 0", path);
+  }
+  result.valid = problems == 0 && errors == 0;
+}
+
+static void runWorker(Pool pool, size_t self) {
+  std::vector<TaskQueue>& queues = *pool.queues;
+  WorkerStats& stats = (*pool.stats)[self];
+  Clock::time_point start = Clock::now();
+
+  // No task creates new ones: once every queue is empty, we're done
+  for (;;) {
+    size_t task;
+    bool found = queues[self].pop(task);
+    for (size_t i = 1; !found && i < queues.size(); i++) {
+      found = queues[(self + i) % queues.size()].steal(task);
+      if (found) {
+        stats.steals++;
+      }
+    }
+    if (!found) {
+      break;
+    }
+
+    Clock::time_point taskStart = Clock::now();
+    Result& result = (*pool.results)[task];
+    validateFile((*pool.tasks)[task], result);
+    result.micros = std::chrono::duration<double, std::micro>(Clock::now() - taskStart).count();
+    stats.files++;
+  }
+  stats.busyMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Collects the files DicePatternSet::walk() finds below one directory
+struct DirectoryWalk {
+  std::vector<Task>* tasks;
+  std::string root;
+};
+
+static void addWalkedFile(const char* path, int priority, const DiceFileInfo& info, void* context) {
+  (void)priority;
+  (void)info;
+  DirectoryWalk& walk = *(DirectoryWalk*)context;
+  Task task;
+  task.root = walk.root;
+  task.name = std::string("/") + path;
+  task.display = walk.root + "/" + path;
+  walk.tasks->push_back(task);
+}
+
+// A file argument becomes root = its directory, name = its base name
+static bool addInput(const char* input, const DicePatternSet& patterns, std::vector<Task>& tasks) {
+  std::string path(input);
+  while (path.size() > 1 && path[path.size() - 1] == '/') {
+    path.erase(path.size() - 1);
+  }
+
+  DicePosixStorage storage;
+  storage.setRoot(path.c_str());
+  if (storage.mount(false)) {
+    DirectoryWalk walk = { &tasks, path };
+    return patterns.walk(storage, addWalkedFile, &walk);
+  }
+
+  Task task;
+  size_t slash = path.rfind('/');
+  task.root = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+  task.name = "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+  task.display = path;
+  tasks.push_back(task);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  const char* patternList = DICE_CONFIG_PATTERNS;
+  bool quiet = false;
+  std::vector<const char*> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      patternList = argv[++i];
+    } else if (strcmp(argv[i], "-q") == 0) {
+      quiet = true;
+    } else if (argv[i][0] != '-') {
+      inputs.push_back(argv[i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (inputs.empty()) {
+    usage();
+    return 2;
+  }
+
+  DicePatternSet patterns;
+  if (!patterns.compile(patternList)) {
+    fprintf(stderr, "invalid pattern list: %s\n", patternList);
+    return 2;
+  }
+
+  std::vector<Task> tasks;
+  bool inputsOk = true;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (!addInput(inputs[i], patterns, tasks)) {
+      fprintf(stderr, "%s: cannot open directory\n", inputs[i]);
+      inputsOk = false;
+    }
+  }
+
+  if (threads == 0) {
+    threads = 1;
+  }
+  if (threads > tasks.size() && !tasks.empty()) {
+    threads = (unsigned)tasks.size();
+  }
+
+  // Contiguous shares; each owner works back to front
+  std::vector<Result> results(tasks.size());
+  std::vector<TaskQueue> queues(threads);
+  std::vector<WorkerStats> stats(threads);
+  for (size_t i = 0; i < tasks.size(); i++) {
+    queues[i * threads / tasks.size()].push(i);
+  }
+  for (size_t i = 0; i < threads; i++) {
+    stats[i].files = 0;
+    stats[i].steals = 0;
+    stats[i].busyMicros = 0;
+  }
+
+  Pool pool = { &tasks, &results, &queues, &stats };
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; i++) {
+    workers.push_back(std::thread(runWorker, pool, (size_t)i));
+  }
+  runWorker(pool, 0);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  double wallMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+  // Report in input order, whatever order the workers finished in
+  size_t invalid = 0;
+  size_t bytes = 0;
+  double fileMicros = 0;
+  std::vector<double> times;
+  size_t slowest = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    fputs(results[i].messages.c_str(), stderr);
+    if (!results[i].valid) {
+      invalid++;
+    }
+    bytes += results[i].bytes;
+    fileMicros += results[i].micros;
+    times.push_back(results[i].micros);
+    if (results[i].micros > results[slowest].micros) {
+      slowest = i;
+    }
+  }
+
+  if (!quiet) {
+    size_t steals = 0;
+    for (size_t i = 0; i < stats.size(); i++) {
+      steals += stats[i].steals;
+    }
+    printf("%u files, %u valid, %u invalid\n", (unsigned)tasks.size(),
+           (unsigned)(tasks.size() - invalid), (unsigned)invalid);
+    printf("wall %.1f ms on %u threads, %.0f files/s, %.1f MB/s\n", wallMicros / 1000,
+           threads, wallMicros > 0 ? tasks.size() * 1e6 / wallMicros : 0.0,
+           wallMicros > 0 ? bytes / wallMicros : 0.0);
+    if (!times.empty()) {
+      std::sort(times.begin(), times.end());
+      printf("per file: mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us (%s)\n",
+             fileMicros / times.size(), times[(times.size() - 1) / 2],
+             times[(times.size() - 1) * 99 / 100], times.back(),
+             tasks[slowest].display.c_str());
+      // Summed file time over wall time: the speedup over one thread,
+      // as long as there are no more threads than cores
+      printf("concurrency %.2f, %u steals\n", wallMicros > 0 ? fileMicros / wallMicros : 0.0,
+             (unsigned)steals);
+    }
+  }
+
+  return inputsOk && invalid == 0 ? 0 : 1;
+}